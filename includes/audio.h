@@ -0,0 +1,93 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sound_queue.h"
+
+// contains the beep synthesizer and the sdl audio device that plays it
+
+#define DEFAULT_VOLUME 500
+#define SAMPLES_PER_SEC 44100
+#define FREQUENCY 256 // freq in hz
+
+// audio device buffer size in samples, smaller buffers lower the latency of the beep
+#define DEFAULT_AUDIO_BUFFER_SIZE 256
+#define MIN_AUDIO_BUFFER_SIZE 128
+#define MAX_AUDIO_BUFFER_SIZE 512
+
+// samples in one period of the precomputed square wave
+#define WAVETABLE_BITS 11
+#define WAVETABLE_SIZE ( 1 << WAVETABLE_BITS )
+
+// time in ms for the beep to fade in or out, long enough to avoid clicks and short enough not to be heard
+#define ENVELOPE_MS 2
+
+/*
+	state of one beep generator, the audio device and offline renderers each own one
+	the square wave is band limited to the sample rate it was initialized with
+*/
+typedef struct {
+	int sample_rate;
+	double cycle;            // emulated cycle the next sample is rendered at
+	bool sound_on;           // beep state after the last applied sound event
+	float wavetable[WAVETABLE_SIZE];
+	uint32_t phase;          // position in the wavetable, the top bits index it
+	uint32_t phase_step;     // phase advanced per sample
+	bool pattern_loaded;     // xo-chip state after the last applied pattern and pitch events
+	uint8_t pattern[SOUND_PATTERN_SIZE];
+	double pattern_step;     // pattern bits advanced per sample at the current pitch
+	double pattern_position; // bit of the xo-chip audio pattern being played
+	float gain;              // envelope level between 0 and 1
+	float gain_step;         // envelope change per sample
+} AudioSynth;
+
+// build the wavetable for sample_rate and silence the generator
+void audio_synth_init(AudioSynth *synth, int sample_rate);
+
+/*
+	render count samples of the beep, or of the xo-chip audio pattern once one is loaded
+	sound events from queue are applied at the sample their cycle falls on, events from before synth->cycle right away
+	the synth only knows the pattern and pitch from events, it never reads the chip8 state
+	cycles_per_sample: emulated cycles that pass per sample, the clock rate divided by the sample rate
+	volume: peak amplitude of the samples
+*/
+void audio_synth_render(AudioSynth *synth, SoundQueue *queue, int16_t *samples, int count, double cycles_per_sample, int volume);
+
+// open the audio device with a buffer of buffer_size samples, sdl must be initialized with SDL_INIT_AUDIO first
+bool audio_init(int buffer_size);
+
+void audio_close(void);
+
+// called by the emulation when the beep starts or stops at cycle
+void audio_queue_sound_event(uint64_t cycle, bool on);
+
+// called by the emulation when an xo-chip program loads a new audio pattern or changes the pitch at cycle
+void audio_queue_pattern_event(uint64_t cycle, const uint8_t *pattern);
+void audio_queue_pitch_event(uint64_t cycle, uint8_t pitch);
+
+/*
+	called by the emulation to tell the audio device how far it has run
+	the device renders sound events a little behind this cycle so that they are queued before their sample is played
+*/
+void audio_sync(uint64_t cycle, uint32_t clock_rate);
+
+/*
+	render count samples from the sound events the emulation queued, for offline rendering without an audio device
+	unlike the device the synth is not held behind the emulation, call it only once the cycles it renders have run
+*/
+void audio_render_offline(AudioSynth *synth, int16_t *samples, int count, uint32_t clock_rate);
+
+/*
+	tell the audio device the emulation runs at speed times real time, 0 when it runs as fast as it can
+	in slow motion beeps are stretched to stay in step with the picture, fast forwarding mutes them
+*/
+void audio_set_speed(double speed);
+
+void audio_set_volume(int vol);
+
+// true: mute, false: un-mute
+void audio_mute_volume(bool mute_flag);
+
+#endif
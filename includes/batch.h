@@ -0,0 +1,130 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "chip8.h"
+
+/*
+	runs many copies of one rom in lockstep, for automated play and search
+	every register, timer and framebuffer is stored as one array per field with an entry per lane (instance)
+	each cycle the lanes are grouped by program counter and opcode, each group is decoded once and executed
+	over all of its lanes with masked loops, which the compiler vectorises in part at -O3
+	lanes seeded apart soon run different code, measured with tools/batchbench the batch is up to 3 times as fast as
+	the same lanes run one by one when they share their input, and about as fast when each lane has its own
+	lanes that diverged are counting sorted by program counter, so grouping costs the same per lane however many
+	groups there are, groups spread thinly over the lanes run lane by lane instead of as masked loops
+
+	lanes run the plain chip8 instruction set with the default quirk profile in 64 by 32 lores mode
+	a lane that reaches a super chip or xo-chip instruction halts on it, see Chip8Batch.halted
+*/
+
+// ram of each lane, the original chip8 address space
+#define BATCH_RAM_SIZE 4096
+
+// lanes only have the lores display, one 64 bit word per row
+#define BATCH_PIXELS_W 64
+#define BATCH_PIXELS_H 32
+
+typedef struct {
+	int count; // lanes
+	int cycles_per_frame; // instructions between two 60hz timer ticks, a whole number so frames have no phase
+	int frame_cycles;     // instructions run since the last timer tick
+
+	// one entry per lane
+	uint8_t *V[V_REGISTERS];
+	uint16_t *I;
+	uint16_t *PC;
+	uint8_t *sp;
+	uint16_t *stack[MAX_STACK_LEVEL];
+	uint8_t *delay_timer;
+	uint8_t *sound_timer;
+	uint16_t *keypad;
+	uint8_t *pressed_key;
+	uint8_t *key_released;
+	uint32_t *random_state;
+	uint8_t *halted; // non zero once the lane reached an instruction it cannot run, its PC stays on it
+
+	uint8_t *ram;           // BATCH_RAM_SIZE bytes per lane, one lane after the other
+	uint64_t *framebuffers; // BATCH_PIXELS_H rows of one word per lane, leftmost pixel in the most significant bit
+	uint64_t *memory_hash;  // the ram and framebuffer terms of batch_hash_lane for each lane, updated on every write
+
+	// rom every lane starts from
+	uint8_t *rom;
+	int rom_size;
+
+	// per lane scratch of the cycle being run
+	uint16_t *opcode;
+	uint8_t *pending; // 0xFF while the lane still has to run the cycle
+	uint8_t *mask;    // 0xFF for the lanes of the group being executed, 0 for every other lane
+
+	// scratch for sorting lanes by program counter once they diverged
+	int *order;           // lanes ordered by program counter
+	int *bucket_end;      // BATCH_RAM_SIZE entries, lanes per program counter while sorting, all 0 between cycles
+	uint16_t *bucket_pcs; // program counters that have lanes this cycle, one entry per lane at most
+	uint64_t *group_keys; // program counter, opcode and lane of lanes on one address with different opcodes
+} Chip8Batch;
+
+// everything of one lane, to save it and load it back into any lane of a batch running the same rom
+typedef struct {
+	uint8_t V[V_REGISTERS];
+	uint16_t I;
+	uint16_t PC;
+	uint8_t sp;
+	uint16_t stack[MAX_STACK_LEVEL];
+	uint8_t delay_timer;
+	uint8_t sound_timer;
+	uint16_t keypad;
+	uint8_t pressed_key;
+	uint8_t key_released;
+	uint32_t random_state;
+	uint8_t halted;
+	uint8_t ram[BATCH_RAM_SIZE];
+	uint64_t framebuffer[BATCH_PIXELS_H];
+	uint64_t memory_hash;
+} BatchLaneState;
+
+/*
+	allocate count lanes running rom, every lane is reset with its own random number generator seeded from seed
+	returns NULL if the rom does not fit into BATCH_RAM_SIZE or memory ran out
+*/
+Chip8Batch *batch_create(int count, const uint8_t *rom, int rom_size, uint32_t seed);
+
+void batch_destroy(Chip8Batch *batch);
+
+// put lane back into the state it was created in, with its random number generator seeded from seed
+void batch_reset_lane(Chip8Batch *batch, int lane, uint32_t seed);
+
+/*
+	copy lane into state and back, frame_cycles is shared by all lanes and not part of it
+	so a state saved between two frames is complete
+*/
+void batch_save_lane(const Chip8Batch *batch, int lane, BatchLaneState *state);
+void batch_load_lane(Chip8Batch *batch, int lane, const BatchLaneState *state);
+
+/*
+	fingerprint of the whole state of lane, equal states give equal fingerprints
+	it is the sum of a hash of each 64 bit word of the state and its position, so a changed word can be swapped out of it
+	the ram and framebuffer terms are kept in memory_hash as they are written, the registers are hashed on each call
+	so it costs the same few words at any instruction boundary
+*/
+uint64_t batch_hash_lane(const Chip8Batch *batch, int lane);
+
+// hash of one word of state at position, the term batch_hash_lane sums
+uint64_t batch_hash_word(uint64_t position, uint64_t word);
+
+// set the pressed keys of every lane, bit n of keypads[lane] is key n
+void batch_set_keypads(Chip8Batch *batch, const uint16_t *keypads);
+
+// run cycles instructions on every lane that has not halted
+void batch_run(Chip8Batch *batch, int cycles);
+
+// run every lane up to and including the next 60hz timer tick, one frame of emulated time
+// from a frame boundary this is always cycles_per_frame instructions
+void batch_run_frame(Chip8Batch *batch);
+
+// framebuffers of all lanes in one contiguous buffer, BATCH_PIXELS_H words per lane
+const uint64_t *batch_get_framebuffers(const Chip8Batch *batch);
+
+#endif
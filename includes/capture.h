@@ -0,0 +1,37 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// records emulated frames to a y4m video or a sequence of png images
+
+// frames waiting to be encoded, once full frames are dropped or the emulation waits
+#define CAPTURE_QUEUE_SIZE 32
+
+// captured frames are the 64 by 32 lores resolution scaled by this factor, hires frames are scaled by half of it
+#define DEFAULT_CAPTURE_SCALE 4
+#define MAX_CAPTURE_SCALE 16
+
+/*
+	start capturing to file_path
+	"-" writes a y4m stream to stdout, console output is moved to stderr so that it does not mix with the video
+	paths ending in .png write one image per frame, frame n of out.png goes to out_00000n.png
+	any other path is written as a y4m file
+	lossless: true to wait for the encoder when the queue is full, false to drop the frame so that capturing never slows the emulation
+	returns false if the output could not be opened
+*/
+bool capture_open(const char *file_path, int scale, bool lossless);
+
+bool capture_is_open(void);
+
+// queue the current frame of the display buffer for encoding
+void capture_frame(void);
+
+// encode the frames still queued and close the output
+void capture_close(void);
+
+// frames dropped because the encoder could not keep up
+uint64_t capture_get_dropped_frames(void);
+
+#endif
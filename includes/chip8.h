@@ -2,12 +2,15 @@
 #define CHIP8_H 
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "input_queue.h"
 
 /*
-	max size in bytes for chip8 ram
+	max size in bytes for chip8 ram, the full 64 KB address space of xo-chip
 	addresses 0x000 - 0x1FF are reserved
 */
-#define RAM_SIZE 4096
+#define RAM_SIZE 65536
 
 // programs are loaded into address 0x200 (byte 512)
 #define PROGRAM_START 0x200
@@ -15,6 +18,16 @@
 // starting address in ram to load the built in font
 #define FONT_START 0x050
 
+// 5 bytes for each of the 16 digits of the built in font
+#define FONT_SIZE 80
+
+// starting address in ram of the 8 by 10 pixel super chip font, right after the small font
+#define BIG_FONT_START 0x0A0
+
+// ram writes are tracked in rows of 8 bytes, matching a row of the gui memory viewer
+#define RAM_ROW_SIZE 8
+#define RAM_ROWS ( RAM_SIZE / RAM_ROW_SIZE )
+
 // number of general purpose registers
 #define V_REGISTERS 16
 
@@ -23,6 +36,32 @@
 
 #define DEFAULT_CLOCK_RATE 500
 
+// clock rates accepted from the command line, the debugger, the rom database and chip8d sessions
+// xo-chip roms are commonly run at thousands of cycles per frame, so the upper bound is well above chip8 rates
+#define MIN_CLOCK_RATE 1
+#define MAX_CLOCK_RATE 1000000
+
+// xo-chip audio pattern of 128 one bit samples
+#define AUDIO_PATTERN_SIZE 16
+
+// pitch register value that plays the audio pattern back at 4000 samples per second
+#define DEFAULT_PITCH 64
+
+/*
+	behaviours that differ between chip8 variants, each profile runs on its own specialised core
+	default keeps the behaviour of this emulator from before profiles existed
+*/
+typedef enum {
+	QUIRKS_DEFAULT,
+	QUIRKS_VIP,    // cosmac vip: logic ops reset VF, FX55/FX65 increment I
+	QUIRKS_SCHIP,  // super chip: shifts act on VX, BXNN jumps to XNN + VX
+	QUIRKS_XOCHIP, // xo-chip: FX55/FX65 increment I, sprites wrap around the screen
+	QUIRK_PROFILES // number of profiles, keep last
+} QuirkProfile;
+
+// a fetch, decode and execute cycle
+typedef void (*chip8_cycle_function)(bool log_flag);
+
 typedef struct {
 	float r;
 	float g;
@@ -45,13 +84,72 @@ typedef struct {
 	uint8_t sp;
 	uint8_t delay_timer;
 	uint8_t sound_timer;
+
+	// instructions executed since reset, timers and sound events are timed in cycles of emulated time
+	uint64_t cycle_count;
+
+	// 60hz timer ticks since reset, one per frame of emulated time
+	uint64_t frame_count;
+
+	// super chip flag registers, saved to by FX75 and restored from by FX85
+	uint8_t rpl_flags[V_REGISTERS];
+
+	// xo-chip audio, the pattern loaded by F002 is looped while the sound timer is non zero
+	// at a playback rate set by the pitch register, the plain beep is used until a pattern is loaded
+	uint8_t audio_pattern[AUDIO_PATTERN_SIZE];
+	uint8_t pitch;
+	bool audio_pattern_loaded;
+
+	// incremented every time a byte in the corresponding row of ram is written
+	// lets a reader of a copy of the state find changed rows without clearing any flags
+	// 32 bits so that a row cannot wrap around to an equal version between two reads, even uncapped
+	// that would take 2^32 writes to one row within a single display frame
+	uint32_t ram_row_version[RAM_ROWS];
+
+	// keypad, each bit is the pressed (1) or released (0) state of one of the 16 keys
+	uint16_t keypad;
+	uint8_t pressed_key;   // key that was last pressed
+	bool is_key_released;  // whether a key was released since FX0A started waiting
+
+	// key events pushed by the ui thread waiting to be applied to the keypad
+	InputQueue input_queue;
+
+	// latency of the most recently applied key event and the worst seen so far
+	uint64_t input_latency, max_input_latency;
+
+	// cycles counted towards the next 60hz timer tick, scaled by 60 so that a tick is due every clock_rate
+	uint32_t timer_cycles;
+
+	// whether the last sound event sent to the audio started the beep
+	bool sound_playing;
+
+	// send sound events and emulation progress to the audio module, only the global instance does
+	bool audio_events;
+
+	QuirkProfile quirk_profile;
+
+	// xorshift state of the CXNN random number generator, never 0
+	uint32_t random_state;
 } Chip8;
 
-extern Chip8 myChip8;
+/*
+	instance the chip8 functions and cores act on, every thread starts out with the global instance
+	servers running many instances bind each one in turn with chip8_bind
+*/
+extern _Thread_local Chip8 *chip8_instance;
+
+// the built in font loaded at FONT_START, defined in font.c
+extern const uint8_t chip8_font[FONT_SIZE];
+#define myChip8 ( *chip8_instance )
+
+// make instance the one the calling thread acts on, NULL binds the global instance again
+// the display state is bound separately with display_bind
+void chip8_bind(Chip8 *instance);
 
 /* 
 	resets all chip8 registers and timers
 	also loads in the font at address 0x050
+	the quirk profile and audio_events are kept
 */
 void chip8_reset();
 
@@ -62,10 +160,49 @@ void chip8_reset();
 */
 int chip8_load_rom(const char* const);
 
+// copy a rom image of size bytes into ram at 0x200, returns false if it does not fit
+bool chip8_load_rom_data(const uint8_t *rom, int size);
+
+/*
+	look up a rom image in the open rom database and apply its quirk profile, clock rate and colors
+	called by chip8_load_rom when a database is open
+	returns false if the rom is not in the database
+*/
+bool chip8_apply_rom_config(const uint8_t *rom, int size);
+
 // a single cycle to fetch, decode, and execute one instruction
 void chip8_run_cycle(bool log_flag);
 
-// decrements delay and sound timers at 60hz when it is non zero
+/*
+	copy the bound instance into state and back, used by run ahead
+	only ram rows whose ram_row_version differs are copied, so a state must be saved from and restored into one instance
+	a zeroed state works for the first save, chip8_reset marks every row
+	the input queue is left out, key events queued in between stay queued
+*/
+void chip8_save_state(Chip8 *state);
+void chip8_restore_state(const Chip8 *state);
+
+// select the quirk profile of the core run by chip8_run_cycle, defaults to QUIRKS_DEFAULT
+void chip8_set_quirk_profile(QuirkProfile profile);
+
+QuirkProfile chip8_get_quirk_profile(void);
+
+const char *chip8_quirk_profile_name(QuirkProfile profile);
+
+// look up a profile by the name returned from chip8_quirk_profile_name, returns false if there is none
+bool chip8_find_quirk_profile(const char *name, QuirkProfile *profile);
+
+/*
+	core of the selected quirk profile
+	call it directly in hot loops to skip the indirection of chip8_run_cycle, fetch it again after changing profile
+*/
+chip8_cycle_function chip8_get_cycle_function(void);
+
+// same as chip8_run_cycle but also counts the instruction in the profiler
+// kept as a separate entry point so the profiler costs nothing when it is not in use
+void chip8_run_cycle_profiled(bool log_flag);
+
+// counts one executed cycle and decrements delay and sound timers at 60hz of emulated time when they are non zero
 void chip8_update_timers();
 
 // sets a key to be in the pressed state
@@ -76,4 +213,23 @@ void chip8_set_key_up(uint8_t key);
 
 uint16_t chip8_get_keypad(void);
 
+/*
+	queue a key event to be applied by the emulation thread at the next instruction boundary
+	timestamp is the performance counter value when the event was captured
+	returns false if the input queue is full and the event was dropped
+*/
+bool chip8_queue_key_event(uint8_t key, bool down, uint64_t timestamp);
+
+/*
+	apply all queued key events to the keypad, only call this between instructions
+	now is the current performance counter value, used to measure input latency
+*/
+void chip8_process_key_events(uint64_t now);
+
+// performance counter ticks between queueing and applying the most recently processed key event
+uint64_t chip8_get_input_latency(void);
+
+// largest input latency in performance counter ticks seen since reset
+uint64_t chip8_get_max_input_latency(void);
+
 #endif
\ No newline at end of file
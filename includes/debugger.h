@@ -0,0 +1,48 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "chip8.h"
+
+// number of slots in the debugger command queue, must be a power of 2
+#define COMMAND_QUEUE_SIZE 32
+
+// consistent copy of the chip8 state published by the emulator for the gui to read
+typedef struct {
+	Chip8 chip8;
+	uint16_t keypad;
+	uint32_t sequence; // sequence number of the publish this snapshot was copied from
+} Chip8Snapshot;
+
+typedef enum {
+	COMMAND_TOGGLE_PAUSE,   // pause or resume the emulator
+	COMMAND_CYCLE_STEP,     // run a single cycle while paused
+	COMMAND_SET_CLOCK_RATE, // set clock rate to value in hz
+} CommandType;
+
+typedef struct {
+	CommandType type;
+	uint32_t value;
+} Command;
+
+/*
+	copy the chip8 state into the shared snapshot, called by the emulation thread once per frame
+	the snapshot is guarded by a seqlock so the emulator never waits on the gui
+*/
+void debugger_publish_snapshot(void);
+
+/*
+	copy the most recently published snapshot into snapshot, called by the gui thread
+	returns false without copying when nothing new was published since snapshot was last filled
+*/
+bool debugger_read_snapshot(Chip8Snapshot *snapshot);
+
+// queue a control change from the gui thread, returns false if the command queue is full
+bool debugger_push_command(CommandType type, uint32_t value);
+
+// apply all queued control changes to the chip8, only call this between instructions
+void debugger_process_commands(void);
+
+#endif
@@ -7,18 +7,44 @@
 
 // contains all utilities for I/O of display for chip8
 
-// chip8 display resolution is 64 by 32 pixels
+// chip8 display resolution is 64 by 32 pixels, super chip hires mode doubles it to 128 by 64
+// the display buffer is always sized for hires mode
 
-#define PIXELS_W 64
-#define PIXELS_H 32
+#define PIXELS_W 128
+#define PIXELS_H 64
 
-// audio settings for square wave beep generator
+#define LORES_PIXELS_W 64
+#define LORES_PIXELS_H 32
 
-#define DEFAULT_VOLUME 500
-#define SAMPLES_PER_SEC 44100
-#define FREQUENCY 256 // freq in hz
-#define PERIOD ( SAMPLES_PER_SEC / FREQUENCY ) // number of samples in a period
-#define HALF_PERIOD  ( PERIOD / 2 ) // number of samples that a wave is held low or high
+// each row of the display buffer is packed 64 pixels to a word, the leftmost pixel in the most significant bit
+#define DISPLAY_ROW_WORDS ( PIXELS_W / 64 )
+
+// xo-chip bitplanes, the planes a pixel is lit in select one of 16 colors
+#define DISPLAY_PLANES 4
+#define DISPLAY_COLORS ( 1 << DISPLAY_PLANES )
+
+// size of the largest packed frame, all planes at hires resolution
+#define DISPLAY_PACKED_SIZE ( DISPLAY_PLANES * PIXELS_W * PIXELS_H / 8 )
+
+/*
+	framebuffer of one chip8 instance, the drawing functions act on the state bound to the calling thread
+	keeps track of the on or off state of every pixel in each plane, packed one bit per pixel
+	a pixel off in all planes is drawn with the background color, on in only the first plane with the foreground color
+	every plane is one contiguous block so clearing and scrolling a plane are single memory operations
+*/
+typedef struct {
+	uint64_t buffer[DISPLAY_PLANES][PIXELS_H][DISPLAY_ROW_WORDS];
+	uint8_t plane_mask; // planes that drawing, clearing and scrolling apply to
+	bool hires;         // lores until a super chip program switches to hires
+	int width, height;  // current resolution in chip8 pixels
+} DisplayState;
+
+// make display_state the one the calling thread draws to, NULL binds the state shown in the window again
+// chip8_reset puts the bound state into lores mode with a clear screen
+void display_bind(DisplayState *display_state);
+
+// the state bound to the calling thread
+DisplayState *display_get_state(void);
 
 // initialize application window
 bool display_init(int display_scale_factor, bool gui_flag);
@@ -29,22 +55,51 @@ void display_close(void);
 // update pixel states with the display buffer
 void display_update(void);
 
-// draw to the display buffer
-// takes in the initial x and y position coordinates of sprite placement
-// and the height of the sprite ranging from 1-15 pixels
-void display_draw(uint8_t x_pos, uint8_t y_pos, uint8_t sprite_height);
+// unpack the display buffer into argb pixels of the current resolution, pixels holds display_get_width() * display_get_height()
+// works without a window, for capturing frames
+void display_get_frame(uint32_t *pixels);
+
+// pack the planes of the current resolution one after another, rows top to bottom and 8 pixels to a byte
+// with the leftmost pixel in the most significant bit, returns the number of bytes written, 256 per plane in lores mode
+int display_get_packed(uint8_t *bytes);
+
+// draw to the selected planes of the display buffer
+// takes in the initial x and y position coordinates of sprite placement, wrapped to the current resolution
+// and the height of the sprite ranging from 1-15 pixels, a height of 0 draws a 16 by 16 super chip sprite
+// each selected plane is drawn with the next sprite in ram, starting with the lowest plane
+// wrap: true to wrap the parts of the sprite past the edges around the screen, false to clip them
+void display_draw(uint8_t x_pos, uint8_t y_pos, uint8_t sprite_height, bool wrap);
+
+// scroll the selected planes of the display buffer down or up by rows pixels
+void display_scroll_down(uint8_t rows);
+void display_scroll_up(uint8_t rows);
+
+// scroll the selected planes of the display buffer 4 pixels left or right
+void display_scroll_left(void);
+void display_scroll_right(void);
+
+// switch between 64 by 32 lores and 128 by 64 hires mode, clears all planes of the display buffer
+void display_set_hires(bool hires);
+
+// select the planes that drawing, clearing and scrolling apply to, bit n of mask selects plane n
+void display_set_planes(uint8_t mask);
+
+uint8_t display_get_planes(void);
+
+bool display_is_hires(void);
+
+// current resolution in chip8 pixels
+int display_get_width(void);
+int display_get_height(void);
 
 // call SDL_RenderClear directly to clear the display
 // does not affect the display buffer
 void display_clear(void);
 
-// clear display buffer so that a subsequent call to display update will clear the screen
+// clear the selected planes of the display buffer so that a subsequent call to display update will clear the screen
 // call display_clear instead to clear the screen directly
 void display_clear_buffer(void);
 
-// pause_on: non-zero to pause audio, 0 to unpause
-void display_pause_audio_device(int pause_on);
-
 SDL_Window *display_get_window(void);
 
 SDL_Renderer *display_get_renderer(void);
@@ -58,9 +113,8 @@ void display_set_bg_color(float r, float g, float b);
 
 void display_set_fg_color(float r, float g, float b);
 
-void display_set_volume(int vol);
+// color of pixels lit in the planes set in the bits of index, 0 is the background and 1 the foreground color
+void display_set_plane_color(int index, float r, float g, float b);
 
-// true: mute, false: un-mute
-void display_mute_volume(bool mute_flag);
 
 #endif
\ No newline at end of file
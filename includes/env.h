@@ -0,0 +1,68 @@
+#ifndef ENV_H
+#define ENV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "batch.h"
+
+/*
+	step and observe interface for training agents, built on a Chip8Batch so it needs neither SDL nor a window
+	an env holds one lane per agent, every call acts on all lanes at once
+
+	observations are the batch framebuffers themselves: BATCH_PIXELS_H words per lane, one bit per pixel with the
+	leftmost pixel in the most significant bit, valid until the next call that changes the env
+	rewards are the weighted change of rom variables in ram over a step, registered with env_add_reward
+	nothing is allocated after env_create
+*/
+
+#define ENV_MAX_REWARDS 8
+
+typedef struct {
+	uint16_t address;
+	uint8_t size; // 1 or 2 bytes, big endian like the chip8 stores 16 bit values
+	float weight; // reward for each unit the value went up, negative to punish it
+} EnvReward;
+
+typedef struct {
+	Chip8Batch *batch;
+
+	EnvReward reward_sources[ENV_MAX_REWARDS];
+	int reward_count;
+	uint16_t *reward_values; // value of each reward source at the end of the last step, ENV_MAX_REWARDS per lane
+	float *rewards;          // reward of each lane over the last step
+} Chip8Env;
+
+// env of lanes copies of rom, reset with seed, returns NULL if the rom does not fit or memory ran out
+Chip8Env *env_create(const uint8_t *rom, int rom_size, int lanes, uint32_t seed);
+
+void env_destroy(Chip8Env *env);
+
+// reset every lane, each gets its own random number sequence derived from seed, returns the first observation
+const uint64_t *env_reset(Chip8Env *env, uint32_t seed);
+
+// reset a single lane, for lanes whose episode ended while the others go on
+void env_reset_lane(Chip8Env *env, int lane, uint32_t seed);
+
+// reward the change of the value of size bytes at address, returns false if ENV_MAX_REWARDS are registered already
+bool env_add_reward(Chip8Env *env, uint16_t address, uint8_t size, float weight);
+
+/*
+	hold down the keys of action_masks[lane] on every lane for frames frames of emulated time, bit n is key n
+	returns the observation and fills the rewards read with env_get_rewards
+*/
+const uint64_t *env_step(Chip8Env *env, const uint16_t *action_masks, int frames);
+
+// reward of every lane over the last step
+const float *env_get_rewards(const Chip8Env *env);
+
+// non zero for lanes that stopped on an instruction the batch cannot run, they need a reset
+const uint8_t *env_get_halted(const Chip8Env *env);
+
+int env_get_lane_count(const Chip8Env *env);
+
+// save the state of lane, restore it later into any lane of an env of the same rom to search from it
+void env_clone_state(const Chip8Env *env, int lane, BatchLaneState *state);
+void env_restore_state(Chip8Env *env, int lane, const BatchLaneState *state);
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef GUI_H
 #define GUI_H
 
+#include <stdbool.h>
+
 #include "SDL.h"
 
 #define GUI_STACK_WIDGET_W 100
@@ -9,8 +11,15 @@
 #define GUI_KEYPAD_W 150
 
 #define GUI_DEBUG_H 150
+#define GUI_PERF_H 150
 #define GUI_GENERAL_H 150
 
+// rate in hz that the gui widgets are rebuilt at, independent of the display refresh
+#define GUI_DEFAULT_REFRESH_RATE 30
+
+// time in milliseconds a single gui rebuild may take before the refresh rate is lowered to compensate
+#define GUI_DEFAULT_FRAME_BUDGET 4.0f
+
 // initialize gui context for nuklear 
 void gui_init();
 
@@ -23,10 +32,19 @@ void gui_input_end();
 
 void gui_handle_event(SDL_Event *event);
 
-// declare and initialize all gui window and widgets
+// set how many times per second the gui widgets are rebuilt
+void gui_set_refresh_rate(int refresh_rate);
+
+// set time budget in milliseconds for rebuilding the gui widgets once
+void gui_set_frame_budget(float budget_ms);
+
+// true when enough time has passed since the last rebuild that the widgets should be rebuilt
+bool gui_refresh_due(void);
+
+// declare and initialize all gui window and widgets, then convert them into vertexes ready to draw
 void gui_create_widgets();
 
-// draw gui by calling nk_sdl_render
+// draw the most recently created gui widgets, can be called every display frame
 void gui_draw();
 
 #endif
\ No newline at end of file
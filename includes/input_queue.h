@@ -0,0 +1,36 @@
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// number of slots in the input queue, must be a power of 2
+#define INPUT_QUEUE_SIZE 64
+
+typedef struct {
+	uint64_t timestamp; // performance counter value at the time the event was captured
+	uint8_t key;        // chip8 key 0x0 - 0xF
+	bool down;          // true: key pressed, false: key released
+} InputEvent;
+
+/*
+	single producer single consumer lock free ring buffer
+	the ui thread is the only producer and the emulation thread the only consumer
+	head and tail are free running counters that are masked when indexing into events
+*/
+typedef struct {
+	InputEvent events[INPUT_QUEUE_SIZE];
+	atomic_uint head; // next event to pop, only written by the consumer
+	atomic_uint tail; // next free slot, only written by the producer
+} InputQueue;
+
+void input_queue_init(InputQueue *queue);
+
+// called by the producer, returns false if the queue is full and the event was dropped
+bool input_queue_push(InputQueue *queue, InputEvent event);
+
+// called by the consumer, returns false if the queue is empty
+bool input_queue_pop(InputQueue *queue, InputEvent *event);
+
+#endif
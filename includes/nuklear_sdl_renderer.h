@@ -17,7 +17,10 @@ NK_API void                 nk_sdl_font_stash_begin(struct nk_font_atlas **atlas
 NK_API void                 nk_sdl_font_stash_end(void);
 NK_API int                  nk_sdl_handle_event(SDL_Event *evt);
 NK_API void                 nk_sdl_render(enum nk_anti_aliasing);
+NK_API void                 nk_sdl_convert(enum nk_anti_aliasing);
+NK_API void                 nk_sdl_draw(void);
 NK_API void                 nk_sdl_shutdown(void);
+NK_API nk_size              nk_sdl_allocation_count(void);
 
 #if SDL_COMPILEDVERSION < SDL_VERSIONNUM(2, 0, 22)
 /* Metal API does not support cliprects with negative coordinates or large
@@ -44,6 +47,9 @@ NK_API void                 nk_sdl_shutdown(void);
 
 struct nk_sdl_device {
     struct nk_buffer cmds;
+    /* vertex and element buffers persist across frames and only ever grow,
+     * so a steady state frame does not touch the heap */
+    struct nk_buffer vbuf, ebuf;
     struct nk_draw_null_texture tex_null;
     SDL_Texture *font_tex;
 };
@@ -60,8 +66,34 @@ static struct nk_sdl {
     struct nk_sdl_device ogl;
     struct nk_context ctx;
     struct nk_font_atlas atlas;
+    struct nk_allocator alloc;
+    nk_size alloc_count;
 } sdl;
 
+/* allocator handed to nuklear for the context and draw buffers,
+ * counts heap allocations so growth after warm-up can be observed */
+NK_INTERN void*
+nk_sdl_alloc(nk_handle unused, void *old, nk_size size)
+{
+    NK_UNUSED(unused);
+    NK_UNUSED(old);
+    sdl.alloc_count++;
+    return malloc(size);
+}
+
+NK_INTERN void
+nk_sdl_free(nk_handle unused, void *ptr)
+{
+    NK_UNUSED(unused);
+    free(ptr);
+}
+
+NK_API nk_size
+nk_sdl_allocation_count(void)
+{
+    return sdl.alloc_count;
+}
+
 
 
 NK_INTERN void
@@ -79,8 +111,46 @@ nk_sdl_device_upload_atlas(const void *image, int width, int height)
     dev->font_tex = g_SDLFontTexture;
 }
 
+/* convert the commands of the frame that was just built into vertexes,
+ * the result is kept so it can be drawn any number of times until the next convert */
 NK_API void
-nk_sdl_render(enum nk_anti_aliasing AA)
+nk_sdl_convert(enum nk_anti_aliasing AA)
+{
+    struct nk_sdl_device *dev = &sdl.ogl;
+
+    /* fill converting configuration */
+    struct nk_convert_config config;
+    static const struct nk_draw_vertex_layout_element vertex_layout[] = {
+        {NK_VERTEX_POSITION, NK_FORMAT_FLOAT, NK_OFFSETOF(struct nk_sdl_vertex, position)},
+        {NK_VERTEX_TEXCOORD, NK_FORMAT_FLOAT, NK_OFFSETOF(struct nk_sdl_vertex, uv)},
+        {NK_VERTEX_COLOR, NK_FORMAT_R8G8B8A8, NK_OFFSETOF(struct nk_sdl_vertex, col)},
+        {NK_VERTEX_LAYOUT_END}
+    };
+    NK_MEMSET(&config, 0, sizeof(config));
+    config.vertex_layout = vertex_layout;
+    config.vertex_size = sizeof(struct nk_sdl_vertex);
+    config.vertex_alignment = NK_ALIGNOF(struct nk_sdl_vertex);
+    config.tex_null = dev->tex_null;
+    config.circle_segment_count = 22;
+    config.curve_segment_count = 22;
+    config.arc_segment_count = 22;
+    config.global_alpha = 1.0f;
+    config.shape_AA = AA;
+    config.line_AA = AA;
+
+    /* convert shapes into vertexes, reusing the memory of the previous frame */
+    nk_buffer_clear(&dev->cmds);
+    nk_buffer_clear(&dev->vbuf);
+    nk_buffer_clear(&dev->ebuf);
+    nk_convert(&sdl.ctx, &dev->cmds, &dev->vbuf, &dev->ebuf, &config);
+
+    /* the draw list lives in dev->cmds, the context can start on the next frame */
+    nk_clear(&sdl.ctx);
+}
+
+/* draw the vertexes of the most recent convert to the screen */
+NK_API void
+nk_sdl_draw(void)
 {
     /* setup global state */
     struct nk_sdl_device *dev = &sdl.ogl;
@@ -96,38 +166,10 @@ nk_sdl_render(enum nk_anti_aliasing AA)
         size_t vt = offsetof(struct nk_sdl_vertex, uv);
         size_t vc = offsetof(struct nk_sdl_vertex, col);
 
-        /* convert from command queue into draw list and draw to screen */
-        const struct nk_draw_command *cmd;
-        const nk_draw_index *offset = NULL;
-        struct nk_buffer vbuf, ebuf;
-
-        /* fill converting configuration */
-        struct nk_convert_config config;
-        static const struct nk_draw_vertex_layout_element vertex_layout[] = {
-            {NK_VERTEX_POSITION, NK_FORMAT_FLOAT, NK_OFFSETOF(struct nk_sdl_vertex, position)},
-            {NK_VERTEX_TEXCOORD, NK_FORMAT_FLOAT, NK_OFFSETOF(struct nk_sdl_vertex, uv)},
-            {NK_VERTEX_COLOR, NK_FORMAT_R8G8B8A8, NK_OFFSETOF(struct nk_sdl_vertex, col)},
-            {NK_VERTEX_LAYOUT_END}
-        };
-        NK_MEMSET(&config, 0, sizeof(config));
-        config.vertex_layout = vertex_layout;
-        config.vertex_size = sizeof(struct nk_sdl_vertex);
-        config.vertex_alignment = NK_ALIGNOF(struct nk_sdl_vertex);
-        config.tex_null = dev->tex_null;
-        config.circle_segment_count = 22;
-        config.curve_segment_count = 22;
-        config.arc_segment_count = 22;
-        config.global_alpha = 1.0f;
-        config.shape_AA = AA;
-        config.line_AA = AA;
-
-        /* convert shapes into vertexes */
-        nk_buffer_init_default(&vbuf);
-        nk_buffer_init_default(&ebuf);
-        nk_convert(&sdl.ctx, &dev->cmds, &vbuf, &ebuf, &config);
-
         /* iterate over and execute each draw command */
-        offset = (const nk_draw_index*)nk_buffer_memory_const(&ebuf);
+        const struct nk_draw_command *cmd;
+        const nk_draw_index *offset = (const nk_draw_index*)nk_buffer_memory_const(&dev->ebuf);
+        const void *vertices = nk_buffer_memory_const(&dev->vbuf);
 
         clipping_enabled = SDL_RenderIsClipEnabled(sdl.renderer);
         SDL_RenderGetClipRect(sdl.renderer, &saved_clip);
@@ -165,14 +207,12 @@ nk_sdl_render(enum nk_anti_aliasing AA)
             }
 
             {
-                const void *vertices = nk_buffer_memory_const(&vbuf);
-
                 SDL_RenderGeometryRaw(sdl.renderer,
                         (SDL_Texture *)cmd->texture.ptr,
                         (const float*)((const nk_byte*)vertices + vp), vs,
                         (const SDL_Color*)((const nk_byte*)vertices + vc), vs,
                         (const float*)((const nk_byte*)vertices + vt), vs,
-                        (vbuf.needed / vs),
+                        (dev->vbuf.needed / vs),
                         (void *) offset, cmd->elem_count, 2);
 
                 offset += cmd->elem_count;
@@ -183,14 +223,16 @@ nk_sdl_render(enum nk_anti_aliasing AA)
         if (!clipping_enabled) {
             SDL_RenderSetClipRect(sdl.renderer, NULL);
         }
-
-        nk_clear(&sdl.ctx);
-        nk_buffer_clear(&dev->cmds);
-        nk_buffer_free(&vbuf);
-        nk_buffer_free(&ebuf);
     }
 }
 
+NK_API void
+nk_sdl_render(enum nk_anti_aliasing AA)
+{
+    nk_sdl_convert(AA);
+    nk_sdl_draw();
+}
+
 static void
 nk_sdl_clipboard_paste(nk_handle usr, struct nk_text_edit *edit)
 {
@@ -237,11 +279,16 @@ nk_sdl_init(SDL_Window *win, SDL_Renderer *renderer)
 #endif
     sdl.win = win;
     sdl.renderer = renderer;
-    nk_init_default(&sdl.ctx, 0);
+    sdl.alloc.userdata = nk_handle_ptr(0);
+    sdl.alloc.alloc = nk_sdl_alloc;
+    sdl.alloc.free = nk_sdl_free;
+    nk_init(&sdl.ctx, &sdl.alloc, 0);
     sdl.ctx.clip.copy = nk_sdl_clipboard_copy;
     sdl.ctx.clip.paste = nk_sdl_clipboard_paste;
     sdl.ctx.clip.userdata = nk_handle_ptr(0);
-    nk_buffer_init_default(&sdl.ogl.cmds);
+    nk_buffer_init(&sdl.ogl.cmds, &sdl.alloc, NK_BUFFER_DEFAULT_INITIAL_SIZE);
+    nk_buffer_init(&sdl.ogl.vbuf, &sdl.alloc, NK_BUFFER_DEFAULT_INITIAL_SIZE);
+    nk_buffer_init(&sdl.ogl.ebuf, &sdl.alloc, NK_BUFFER_DEFAULT_INITIAL_SIZE);
     return &sdl.ctx;
 }
 
@@ -373,6 +420,8 @@ void nk_sdl_shutdown(void)
     SDL_DestroyTexture(dev->font_tex);
     /* glDeleteTextures(1, &dev->font_tex); */
     nk_buffer_free(&dev->cmds);
+    nk_buffer_free(&dev->vbuf);
+    nk_buffer_free(&dev->ebuf);
     memset(&sdl, 0, sizeof(sdl));
 }
 
@@ -0,0 +1,69 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// number of most recent frames kept for the frame time graph and percentiles
+#define PERF_FRAME_HISTORY 240
+
+// a frame taking longer than this many milliseconds counts as dropped, two frames at 60hz
+#define PERF_DROPPED_FRAME_MS 33.3f
+
+typedef struct {
+	double instructions_per_second;   // achieved over the last second
+	uint32_t target_instructions_per_second; // clock rate the emulator is set to
+	uint64_t instructions;            // total instructions executed
+
+	float frame_time_ms;              // duration of the most recent frame
+	float frame_time_p50_ms;          // median frame time over the frame history
+	float frame_time_p99_ms;          // 99th percentile frame time over the frame history
+	float emulation_time_ms;          // average time per frame spent running instructions
+	float render_time_ms;             // average time per frame spent drawing and presenting
+	float run_ahead_time_ms;          // average time of the frames that ran ahead spent saving, running ahead and restoring
+
+	uint64_t frames;
+	uint64_t dropped_frames;          // frames that took longer than PERF_DROPPED_FRAME_MS
+	uint64_t audio_underruns;         // audio callbacks that arrived late enough for the device to starve
+} PerfStats;
+
+// clear all statistics
+void perf_reset(void);
+
+// mark the start of a main loop iteration
+void perf_frame_begin(void);
+
+// add instructions executed and performance counter ticks spent executing them this frame
+void perf_record_emulation(uint32_t instructions, uint64_t ticks);
+
+// add performance counter ticks spent drawing and presenting this frame
+void perf_record_render(uint64_t ticks);
+
+// add performance counter ticks spent on run ahead this frame, its instructions are not counted as executed
+void perf_record_run_ahead(uint64_t ticks);
+
+// mark the end of a main loop iteration
+void perf_frame_end(void);
+
+/*
+	called from the audio callback with the number of samples it is asked for
+	a callback arriving later than the previous buffer takes to play back counts as an underrun
+*/
+void perf_audio_callback(int samples, int sample_rate);
+
+// the audio device was paused or resumed, the gap in callbacks is not an underrun
+void perf_audio_restart(void);
+
+// fill stats with the current statistics, cheap enough for a gui to call every refresh
+void perf_get_stats(PerfStats *stats);
+
+/*
+	frame times in milliseconds of the last PERF_FRAME_HISTORY frames, oldest first
+	returns the number of frames written into frame_times
+*/
+int perf_get_frame_times(float frame_times[PERF_FRAME_HISTORY]);
+
+// print stats to stdout, used at the end of headless runs
+void perf_print_stats(const PerfStats *stats);
+
+#endif
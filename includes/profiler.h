@@ -0,0 +1,74 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "chip8.h"
+
+// default number of instructions between two samples of the guest call stack
+#define PROFILER_DEFAULT_SAMPLE_INTERVAL 16
+
+// maximum number of distinct call stacks the sampler can tell apart
+#define PROFILER_MAX_STACKS 4096
+
+// every distinct chip8 instruction the profiler counts executions of
+typedef enum {
+	OPCODE_00E0, OPCODE_00EE, OPCODE_00CN, OPCODE_00DN, OPCODE_00FB, OPCODE_00FC, OPCODE_00FD, OPCODE_00FE, OPCODE_00FF, OPCODE_0NNN,
+	OPCODE_1NNN, OPCODE_2NNN, OPCODE_3XNN, OPCODE_4XNN, OPCODE_5XY0, OPCODE_5XY2, OPCODE_5XY3, OPCODE_6XNN, OPCODE_7XNN,
+	OPCODE_8XY0, OPCODE_8XY1, OPCODE_8XY2, OPCODE_8XY3, OPCODE_8XY4, OPCODE_8XY5, OPCODE_8XY6, OPCODE_8XY7, OPCODE_8XYE,
+	OPCODE_9XY0, OPCODE_ANNN, OPCODE_BNNN, OPCODE_CXNN, OPCODE_DXYN,
+	OPCODE_EX9E, OPCODE_EXA1,
+	OPCODE_F000, OPCODE_FN01, OPCODE_F002, OPCODE_FX07, OPCODE_FX0A, OPCODE_FX15, OPCODE_FX18, OPCODE_FX1E, OPCODE_FX29, OPCODE_FX30, OPCODE_FX33, OPCODE_FX3A, OPCODE_FX55, OPCODE_FX65, OPCODE_FX75, OPCODE_FX85,
+	OPCODE_INVALID,
+	OPCODE_CLASSES // number of opcode classes, keep last
+} OpcodeClass;
+
+// turn counting on or off and clear all counters
+void profiler_enable(bool enable);
+
+bool profiler_enabled(void);
+
+// sample the guest call stack every interval instructions, 0 turns sampling off, also clears all samples
+void profiler_enable_stack_sampling(uint32_t interval);
+
+bool profiler_stack_sampling_enabled(void);
+
+// zero all counters
+void profiler_reset(void);
+
+// count one execution of opcode at address pc and sample the call stack when due
+// called from the instrumented cycle only
+void profiler_record(uint16_t pc, uint16_t opcode);
+
+OpcodeClass profiler_opcode_class(uint16_t opcode);
+
+// name of opcode class in the usual XYN notation, for example "8XY4"
+const char *profiler_opcode_class_name(OpcodeClass opcode_class);
+
+// number of times the instruction at address was executed
+uint64_t profiler_get_pc_count(uint16_t address);
+
+// highest count of any single address, used to scale the heatmap
+uint64_t profiler_get_max_pc_count(void);
+
+uint64_t profiler_get_opcode_count(OpcodeClass opcode_class);
+
+// total number of instructions counted
+uint64_t profiler_get_total_count(void);
+
+/*
+	write addresses and opcode classes sorted from most to least executed
+	returns false if the report could not be written
+*/
+bool profiler_write_report(const char *file_path);
+
+/*
+	write sampled call stacks in the collapsed stack format used by flamegraph tools
+	one line per distinct stack, frames are subroutine entry addresses from outermost to innermost
+	returns false if the file could not be written
+*/
+bool profiler_write_collapsed_stacks(const char *file_path);
+
+#endif
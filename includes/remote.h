@@ -0,0 +1,66 @@
+#ifndef REMOTE_H
+#define REMOTE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "display.h"
+
+/*
+	serves the display to remote viewers over a unix domain socket and takes their keypad input
+	only available on unix like systems
+
+	server to viewer, one message per frame that changed:
+		byte 0: REMOTE_KEYFRAME or REMOTE_DELTA
+		byte 1, 2: width and height of the frame in pixels
+		byte 3, 4: length of the payload, little endian
+		payload: the packed frame of display_get_packed xored with the previous frame sent, all zeros for a keyframe
+		the payload is run length encoded as pairs of a byte counting unchanged bytes to skip and a byte counting changed
+		bytes that follow it, until the frame is covered
+	a viewer is sent a keyframe when it connects, whenever the resolution changes and when a delta would not fit in REMOTE_MAX_PAYLOAD_SIZE
+
+	viewer to server, 2 bytes per key event:
+		byte 0: key 0x0 - 0xF
+		byte 1: 1 for pressed, 0 for released
+*/
+
+#define REMOTE_KEYFRAME 'K'
+#define REMOTE_DELTA 'D'
+
+#define REMOTE_HEADER_SIZE 5
+
+// the worst case is changed and unchanged bytes alternating, each changed byte then costs its own 2 count bytes
+// that is 3 bytes for every 2 of the frame, plus the counts of a last unchanged run
+#define REMOTE_MAX_PAYLOAD_SIZE ( DISPLAY_PACKED_SIZE * 3 / 2 + 2 )
+
+#define REMOTE_MAX_VIEWERS 16
+
+// bytes queued per viewer that has not read them yet, slower viewers are disconnected
+#define REMOTE_BUFFER_SIZE 65536
+
+/*
+	run length encode the xor of frame and base into payload, base NULL encodes a keyframe
+	returns the payload size, or -1 if it would not fit in capacity bytes
+*/
+int remote_encode_frame(const uint8_t *frame, const uint8_t *base, int size, uint8_t *payload, int capacity);
+
+// write the header of a message with a payload of payload_size bytes
+void remote_write_header(uint8_t *message, uint8_t type, int width, int height, int payload_size);
+
+// listen for viewers on a socket created at socket_path, replacing any file there, returns false if it cannot
+bool remote_open(const char *socket_path);
+
+bool remote_is_open(void);
+
+// accept new viewers, queue their key events and send them what is pending, never blocks
+void remote_poll(void);
+
+// send the display to every viewer if it changed since the last frame sent
+void remote_send_frame(void);
+
+// disconnect all viewers and remove the socket
+void remote_close(void);
+
+int remote_get_viewer_count(void);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef ROMDB_H
+#define ROMDB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sha1.h"
+
+/*
+	rom metadata database, a file of fixed size entries sorted by the sha-1 of the rom image
+	the file is memory mapped and searched in place, nothing is parsed or copied when it is opened
+
+	layout, all values little endian:
+	RomDbHeader
+	RomDbEntry[header.count] sorted by sha1 in ascending byte order
+*/
+
+#define ROMDB_MAGIC "CH8ROMDB"
+#define ROMDB_VERSION 1
+
+// colors stored per rom: background, foreground and the two extra xo-chip plane colors
+#define ROMDB_COLORS 4
+
+// platform a rom was written for
+typedef enum {
+	PLATFORM_CHIP8,
+	PLATFORM_SCHIP,
+	PLATFORM_XOCHIP,
+	PLATFORMS // number of platforms, keep last
+} Platform;
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t count;
+} RomDbHeader;
+
+typedef struct {
+	uint8_t sha1[SHA1_DIGEST_SIZE];
+	uint8_t platform;             // Platform
+	uint8_t quirk_profile;        // QuirkProfile
+	uint16_t cycles_per_frame;    // recommended instructions per 60hz frame, 0 keeps the current clock rate
+	uint32_t colors[ROMDB_COLORS]; // 0xAARRGGBB, an alpha of 0 keeps the current color
+} RomDbEntry;
+
+/*
+	map a database file, closing any open one first
+	returns false if the file cannot be mapped or is not a valid database
+*/
+bool romdb_open(const char *file_path);
+
+void romdb_close(void);
+
+bool romdb_is_open(void);
+
+// binary search the open database, returns NULL if the rom is not in it or no database is open
+const RomDbEntry *romdb_find(const uint8_t sha1[SHA1_DIGEST_SIZE]);
+
+const char *romdb_platform_name(Platform platform);
+
+// look up a platform by the name returned from romdb_platform_name, returns false if there is none
+bool romdb_find_platform(const char *name, Platform *platform);
+
+#endif
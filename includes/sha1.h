@@ -0,0 +1,27 @@
+#ifndef SHA1_H
+#define SHA1_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// size in bytes of a sha-1 digest
+#define SHA1_DIGEST_SIZE 20
+
+typedef struct {
+	uint32_t state[5];
+	uint64_t length;     // bytes hashed so far
+	uint8_t block[64];   // input waiting for a full block
+	uint32_t block_used;
+} Sha1;
+
+void sha1_init(Sha1 *sha);
+
+void sha1_update(Sha1 *sha, const void *data, size_t size);
+
+// finish the hash and write the digest, sha must be initialized again before reuse
+void sha1_final(Sha1 *sha, uint8_t digest[SHA1_DIGEST_SIZE]);
+
+// hash a whole buffer in one call
+void sha1(const void *data, size_t size, uint8_t digest[SHA1_DIGEST_SIZE]);
+
+#endif
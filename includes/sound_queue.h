@@ -0,0 +1,50 @@
+#ifndef SOUND_QUEUE_H
+#define SOUND_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// number of slots in the sound queue, must be a power of 2
+#define SOUND_QUEUE_SIZE 256
+
+// bytes of an xo-chip audio pattern carried by a SOUND_PATTERN event
+#define SOUND_PATTERN_SIZE 16
+
+typedef enum {
+	SOUND_STOP,    // beep stops
+	SOUND_START,   // beep starts
+	SOUND_PITCH,   // xo-chip pitch register changed
+	SOUND_PATTERN, // xo-chip audio pattern loaded
+} SoundEventType;
+
+typedef struct {
+	uint64_t cycle; // emulated cycle the event takes effect on
+	uint8_t type;   // one of SoundEventType
+	uint8_t pitch;  // new pitch of a SOUND_PITCH event
+	uint8_t pattern[SOUND_PATTERN_SIZE]; // new pattern of a SOUND_PATTERN event
+} SoundEvent;
+
+/*
+	single producer single consumer lock free ring buffer
+	the emulation thread is the only producer and the audio renderer the only consumer
+	head and tail are free running counters that are masked when indexing into events
+*/
+typedef struct {
+	SoundEvent events[SOUND_QUEUE_SIZE];
+	atomic_uint head; // next event to pop, only written by the consumer
+	atomic_uint tail; // next free slot, only written by the producer
+} SoundQueue;
+
+void sound_queue_init(SoundQueue *queue);
+
+// called by the producer, returns false if the queue is full and the event was dropped
+bool sound_queue_push(SoundQueue *queue, SoundEvent event);
+
+// called by the consumer, reads the next event without removing it, returns false if the queue is empty
+bool sound_queue_peek(SoundQueue *queue, SoundEvent *event);
+
+// called by the consumer, returns false if the queue is empty
+bool sound_queue_pop(SoundQueue *queue, SoundEvent *event);
+
+#endif
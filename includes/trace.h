@@ -0,0 +1,40 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// number of phase timings kept, older timings are overwritten once full, must be a power of 2
+#define TRACE_BUFFER_SIZE 65536
+
+// phases of a main loop iteration that are timed
+typedef enum {
+	TRACE_EVENT_POLLING,
+	TRACE_EMULATION,
+	TRACE_RUN_AHEAD,
+	TRACE_GUI_CREATE_WIDGETS,
+	TRACE_DISPLAY_UPDATE,
+	TRACE_GUI_DRAW,
+	TRACE_DISPLAY_PRESENT,
+	TRACE_FRAME_OUTPUT, // capture, remote viewers and wav rendering of a headless run
+	TRACE_PHASES // number of phases, keep last
+} TracePhase;
+
+// start or stop recording phase timings, enabling also clears previously recorded timings
+void trace_enable(bool enable);
+
+bool trace_enabled(void);
+
+// returns the monotonic timestamp a phase starts at, pass it on to trace_end
+uint64_t trace_begin(void);
+
+// record phase as having run from start until now
+void trace_end(TracePhase phase, uint64_t start);
+
+/*
+	write the recorded timings as chrome trace event json, viewable in perfetto or chrome://tracing
+	returns false if the file could not be written
+*/
+bool trace_write_chrome_json(const char *file_path);
+
+#endif
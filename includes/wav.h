@@ -0,0 +1,27 @@
+#ifndef WAV_H
+#define WAV_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+	streams 16 bit mono pcm samples into a wav file
+	the header is written up front with empty sizes and filled in when the file is closed
+*/
+typedef struct {
+	FILE *file;
+	int sample_rate;
+	uint32_t data_size; // bytes of samples written so far
+} WavWriter;
+
+// create the file at file_path and write its header, returns false if it could not be created
+bool wav_open(WavWriter *wav, const char *file_path, int sample_rate);
+
+// append count samples, returns false if they could not be written
+bool wav_write(WavWriter *wav, const int16_t *samples, int count);
+
+// fill in the sizes of the header and close the file, returns false if the file could not be finished
+bool wav_close(WavWriter *wav);
+
+#endif
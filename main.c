@@ -1,27 +1,105 @@
 //#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
+#include <math.h>
 
 #include "SDL.h"
 
 #include "./includes/chip8.h"
 #include "./includes/display.h"
 #include "./includes/gui.h"
+#include "./includes/debugger.h"
+#include "./includes/profiler.h"
+#include "./includes/trace.h"
+#include "./includes/perf.h"
+#include "./includes/romdb.h"
+#include "./includes/audio.h"
+#include "./includes/wav.h"
+#include "./includes/capture.h"
+#include "./includes/remote.h"
 
 void process_key_input_down(SDL_Event *e); 
 void process_key_input_up(SDL_Event *e); 
 bool process_command_line_args(int argc, char *argv[]);
+int run_headless(uint32_t frames, void (*run_cycle)(bool));
+void write_reports(void);
+void capture_frames(void);
+void close_capture(void);
+void run_ahead(uint32_t frames);
+void set_emulation_speed(double speed);
 
 static bool log_flag = false, gui_flag = true;
 
 static const char *rom_path_arg = NULL;
 
+// file to write the profiler report to on exit, profiling is off when NULL
+static const char *profile_path_arg = NULL;
+
+// file to write sampled guest call stacks to on exit, stack sampling is off when NULL
+static const char *flamegraph_path_arg = NULL;
+
+// instructions between two call stack samples
+static uint32_t sample_interval = PROFILER_DEFAULT_SAMPLE_INTERVAL;
+
+// file to write main loop phase timings to on exit, tracing is off when NULL
+static const char *trace_path_arg = NULL;
+
+// number of frames to run without a window as fast as possible, 0 runs normally with a window
+static uint32_t headless_frames = 0;
+
+// rom database to configure the rom from, not used when NULL
+static const char *rom_database_arg = NULL;
+
+// clock rate and quirk profile given on the command line, they take precedence over the rom database
+static uint32_t clock_rate = 0; // 0 when not given
+static bool quirk_profile_given = false;
+static QuirkProfile quirk_profile = QUIRKS_DEFAULT;
+
 // default scaling factor of the 64 by 32 pixel display
 // 15 is the default
 static uint32_t display_scale =  15;
 
+static int gui_refresh_rate = GUI_DEFAULT_REFRESH_RATE;
+
+// audio device buffer size in samples
+static int audio_buffer_size = DEFAULT_AUDIO_BUFFER_SIZE;
+
+// file to render the audio of a headless run to, no audio is rendered when NULL
+static const char *wav_path_arg = NULL;
+static int wav_sample_rate = SAMPLES_PER_SEC;
+
+// file to capture emulated frames to, frames are not captured when NULL
+static const char *capture_path_arg = NULL;
+static int capture_scale = DEFAULT_CAPTURE_SCALE;
+
+// emulated frames handed to the capture so far
+static uint64_t frames_captured = 0;
+
+// unix socket to serve the display to remote viewers on, not served when NULL
+static const char *remote_socket_arg = NULL;
+
+// frames shown ahead of the emulation to hide the input lag of the rom, 0 shows the emulation itself
+#define MAX_RUN_AHEAD_FRAMES 8
+static uint32_t run_ahead_frames = 0;
+
+// display of the last frame run ahead, drawn in place of the emulated display
+static DisplayState ahead_display;
+
+// speed of the emulation relative to real time, independent of the clock rate of the rom, 0 runs as fast as possible
+static double emulation_speed = 1.0;
+#define MIN_EMULATION_SPEED 0.1
+#define MAX_EMULATION_SPEED 16.0
+
+// speeds stepped through by the F6 and F7 hotkeys, slowest first
+static const double speed_steps[] = { 0.25, 0.5, 1.0, 2.0, 4.0, 8.0, 0.0 };
+#define SPEED_STEPS ( sizeof speed_steps / sizeof speed_steps[0] )
+
+// instructions run between two checks of the time while uncapped
+#define UNCAPPED_BATCH_SIZE 4096
+
 int main(int argc, char *argv[])
 {
 	srand(time(NULL));
@@ -31,29 +109,69 @@ int main(int argc, char *argv[])
 
 	if( !process_command_line_args(argc, argv) ) return EXIT_FAILURE;
 
-	// attempt to load rom file into chip8 ram
+	// open the capture before anything is printed, a video on stdout moves console output to stderr
+	// headless runs wait for the encoder so that the video has every frame
+	if ( capture_path_arg && !capture_open(capture_path_arg, capture_scale, headless_frames > 0) ) return EXIT_FAILURE;
+
+	if ( rom_database_arg && !romdb_open(rom_database_arg) ) return EXIT_FAILURE;
+
+	// attempt to load rom file into chip8 ram, also applies its rom database entry
 	if ( !chip8_load_rom(rom_path_arg) ) return EXIT_FAILURE;
 
+	if (clock_rate) myChip8.clock_rate = clock_rate;
+	if (quirk_profile_given) chip8_set_quirk_profile(quirk_profile);
+
 	printf("program loaded!\n");
 
+	if ( remote_socket_arg && !remote_open(remote_socket_arg) ) return EXIT_FAILURE;
+
+	// pick the instrumented cycle once up front so the profiler adds no cost per instruction when disabled
+	profiler_enable(profile_path_arg != NULL);
+	profiler_enable_stack_sampling(flamegraph_path_arg ? sample_interval : 0);
+	// the core of the selected quirk profile is called directly
+	void (*run_cycle)(bool) = ( profiler_enabled() || profiler_stack_sampling_enabled() ) ? chip8_run_cycle_profiled : chip8_get_cycle_function();
+
+	perf_reset();
+	trace_enable(trace_path_arg != NULL);
+
+	if (headless_frames > 0) return run_headless(headless_frames, run_cycle);
+
 	// initialize display scaled to the display scale factor,default value of 15
 	if ( !display_init(display_scale, gui_flag) ) return EXIT_FAILURE;
+	if ( !audio_init(audio_buffer_size) ) return EXIT_FAILURE;
 
 	gui_init();
+	gui_set_refresh_rate(gui_refresh_rate);
 
 	SDL_Event event;
    bool quit_flag = false; 
 
+	set_emulation_speed(emulation_speed);
+
 	// timers to lock chip8 speed into a specified clock speed
 
-	float delta_time = 0; // seconds passed in beween loop iterations
-	float delta_time_limit;
-	clock_t current_time; 
-	clock_t previous_time = clock();
+	const uint64_t counter_frequency = SDL_GetPerformanceFrequency();
+	uint64_t current_time;
+	uint64_t previous_time = SDL_GetPerformanceCounter();
+	uint64_t previous_render_time = 0;
+	bool frame_skipped = false;
+	double cycles_owed = 0;
+
+	// emulated frame, keys and time of the last run ahead, its display is reused until one of them moves on
+	uint64_t ahead_frame = UINT64_MAX;
+	uint32_t ahead_keys = 0;
+	uint64_t ahead_time = 0; // cycles that are due to run based on time passed, clock rate and emulation speed
+
+	uint64_t phase_start;
+
 	// main loop
    while(!quit_flag)
    { 
+		// a skipped frame carries on into the next iteration, perf measures the frames that are drawn
+		if (!frame_skipped) perf_frame_begin();
+
 		// process sdl events in the window
+		phase_start = trace_begin();
 		gui_input_begin();
 		while(SDL_PollEvent( &event ))
       { 
@@ -74,113 +192,375 @@ int main(int argc, char *argv[])
 			gui_handle_event(&event);
       }
 		gui_input_end();
+		trace_end(TRACE_EVENT_POLLING, phase_start);
 
 		// exit if close window is pressed
 		if (quit_flag) break;
 
-		if (!myChip8.pause_flag)
+		// apply key events queued by the event loop and the gui keypad before the next instruction
+		chip8_process_key_events( SDL_GetPerformanceCounter() );
+
+		// apply pause, step and clock rate changes requested by the gui and hotkeys
+		debugger_process_commands();
+
+		current_time = SDL_GetPerformanceCounter();
+		phase_start = trace_begin();
+		uint32_t cycles_run = 0;
+
+		if (!myChip8.pause_flag && emulation_speed == 0)
 		{
-			delta_time_limit = (float) 1 / myChip8.clock_rate;
-			current_time = clock();
+			// uncapped, run batches of instructions for a display frame of real time and draw once
+			uint64_t deadline = current_time + counter_frequency / 60;
 
-			delta_time +=  (float) ( current_time - previous_time ) / CLOCKS_PER_SEC;
-			if ( delta_time >= delta_time_limit ) 
+			do
 			{
-				delta_time = delta_time_limit; // limit delta time
-			}
+				for (int i = 0; i < UNCAPPED_BATCH_SIZE; ++i) run_cycle(log_flag);
+				cycles_run += UNCAPPED_BATCH_SIZE;
+			} while (SDL_GetPerformanceCounter() < deadline);
+
+			cycles_owed = 0;
+		}
+		else if (!myChip8.pause_flag)
+		{
+			double cycles_per_second = myChip8.clock_rate * emulation_speed;
+			cycles_owed += (double) ( current_time - previous_time ) * cycles_per_second / counter_frequency;
 
-			previous_time = current_time;
+			// do not try to catch up on more than a tenth of a second after a stall
+			if ( cycles_owed > cycles_per_second / 10.0 ) cycles_owed = cycles_per_second / 10.0;
 
-			// lock chip8 to run at specified clockrate
-			if ( delta_time == delta_time_limit )
+			// run every cycle that is due in one batch so a slow gui or display frame
+			// does not lower the number of instructions executed per second
+			while ( cycles_owed >= 1 )
 			{
-				chip8_run_cycle(log_flag);
-
-				delta_time = 0;
+				run_cycle(log_flag);
+				cycles_owed -= 1;
+				cycles_run++;
 			}
 		}
 		else if (myChip8.cycle_step_flag) // when chip8 is paused, allow stepping through a single cycle 
 		{
-			chip8_run_cycle(log_flag);
+			run_cycle(log_flag);
 			myChip8.cycle_step_flag = false;
+			cycles_run++;
+		}
+
+		previous_time = current_time;
+		trace_end(TRACE_EMULATION, phase_start);
+		perf_record_emulation(cycles_run, SDL_GetPerformanceCounter() - current_time);
+
+		capture_frames();
+
+		// take key events from remote viewers and send them what changed
+		remote_poll();
+		remote_send_frame();
+
+		// away from normal speed the window is drawn at 60hz of real time and the frames in between are skipped
+		// so that fast forwarding is not held back by drawing and slow motion does not redraw the same frame
+		uint64_t render_time = SDL_GetPerformanceCounter();
+		frame_skipped = emulation_speed != 1.0 && render_time - previous_render_time < counter_frequency / 60;
+		if (frame_skipped) continue;
+		previous_render_time = render_time;
+
+		// a paused emulation shows its own display so that stepping shows each instruction
+		bool show_ahead = run_ahead_frames > 0 && !myChip8.pause_flag;
+
+		// the emulation is deterministic, so running ahead again before an emulated frame passed or a key changed
+		// ends on the same frame and the display of the last run is drawn instead, so it runs once per emulated
+		// frame rather than every time around the loop, a 60hz refresh picks up anything else like a new clock rate
+		uint32_t keys = myChip8.keypad | myChip8.pressed_key << 16 | (uint32_t) myChip8.is_key_released << 24;
+		bool ahead_due = myChip8.frame_count != ahead_frame || keys != ahead_keys || render_time - ahead_time >= counter_frequency / 60;
+
+		if (show_ahead && ahead_due)
+		{
+			ahead_frame = myChip8.frame_count;
+			ahead_keys = keys;
+			ahead_time = render_time;
+
+			phase_start = trace_begin();
+			uint64_t run_ahead_start = SDL_GetPerformanceCounter();
+			run_ahead(run_ahead_frames);
+			perf_record_run_ahead(SDL_GetPerformanceCounter() - run_ahead_start);
+			trace_end(TRACE_RUN_AHEAD, phase_start);
 		}
 
-		if (gui_flag) gui_create_widgets(); // declare and initialize gui widgets
+		// rebuild the gui at its own refresh rate, the last built gui is redrawn every display frame
+		if (gui_flag && gui_refresh_due())
+		{
+			phase_start = trace_begin();
+			debugger_publish_snapshot(); // publish chip8 state for the gui to read
+			gui_create_widgets();        // declare and initialize gui widgets
+			trace_end(TRACE_GUI_CREATE_WIDGETS, phase_start);
+		}
+
+		uint64_t render_start = SDL_GetPerformanceCounter();
+
+		phase_start = trace_begin();
 		display_clear();                    // clear the display before draw
+		if (show_ahead) display_bind(&ahead_display);
 		display_update();                   // set display rectangles (pixels) to correct the color with display buffer 
-		if (gui_flag) gui_draw();           // draw the gui widgets
+		display_bind(NULL);
+		trace_end(TRACE_DISPLAY_UPDATE, phase_start);
+
+		if (gui_flag) 
+		{
+			phase_start = trace_begin();
+			gui_draw();                      // draw the gui widgets
+			trace_end(TRACE_GUI_DRAW, phase_start);
+		}
+
+		phase_start = trace_begin();
 		display_present();                  // render changes to display
+		trace_end(TRACE_DISPLAY_PRESENT, phase_start);
+
+		perf_record_render(SDL_GetPerformanceCounter() - render_start);
+		perf_frame_end();
    }
 
+	write_reports();
+	close_capture();
+	remote_close();
+
 	gui_close();
+	audio_close();
 	display_close();
 	
 	return EXIT_SUCCESS;
 }
 
+void set_emulation_speed(double speed)
+{
+	emulation_speed = speed;
+	audio_set_speed(speed);
+
+	if (speed == 0) printf("speed: uncapped\n");
+	else printf("speed: %gx\n", speed);
+}
+
+// step to the next slower (-1) or faster (1) speed of speed_steps
+static void step_emulation_speed(int direction)
+{
+	// the step nearest to the speed in the direction, so a speed between two steps moves to its neighbour
+	// uncapped counts as the fastest of all
+	double current = emulation_speed == 0 ? INFINITY : emulation_speed;
+	int next = -1;
+
+	for (int i = 0; i < (int) SPEED_STEPS; ++i)
+	{
+		double step = speed_steps[i] == 0 ? INFINITY : speed_steps[i];
+
+		if (direction < 0 && step < current && ( next < 0 || step > speed_steps[next] )) next = i;
+		if (direction > 0 && step > current && next < 0) next = i;
+	}
+
+	if (next >= 0) set_emulation_speed(speed_steps[next]);
+}
+
+// run frames ahead of the emulation with the keys held now into ahead_display, then put the emulation back
+void run_ahead(uint32_t frames)
+{
+	static Chip8 saved;
+	chip8_save_state(&saved);
+
+	memcpy(&ahead_display, display_get_state(), sizeof ahead_display);
+	display_bind(&ahead_display);
+
+	// frames run ahead are thrown away, they must not be heard or profiled
+	myChip8.audio_events = false;
+	chip8_cycle_function run_cycle = chip8_get_cycle_function();
+
+	uint64_t last_frame = myChip8.frame_count + frames;
+	while (myChip8.frame_count < last_frame) run_cycle(false);
+
+	display_bind(NULL);
+	chip8_restore_state(&saved);
+}
+
+int run_headless(uint32_t frames, void (*run_cycle)(bool))
+{
+	printf("running %u frames headless\n", frames);
+
+	double cycles_owed = 0;
+
+	// with remote viewers watching and playing, frames are paced to real time instead of run as fast as possible
+	const uint64_t counter_frequency = SDL_GetPerformanceFrequency();
+	uint64_t frame_deadline = SDL_GetPerformanceCounter();
+
+	// audio is rendered after each frame from the sound events its cycles queued
+	static AudioSynth synth;
+	static int16_t samples[4096];
+	WavWriter wav;
+	uint64_t samples_rendered = 0;
+
+	if (wav_path_arg)
+	{
+		if ( !wav_open(&wav, wav_path_arg, wav_sample_rate) ) return EXIT_FAILURE;
+		audio_synth_init(&synth, wav_sample_rate);
+	}
+
+	uint64_t phase_start;
+
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		perf_frame_begin();
+
+		if ( remote_is_open() )
+		{
+			frame_deadline += counter_frequency / 60;
+			while (SDL_GetPerformanceCounter() < frame_deadline) SDL_Delay(1);
+
+			phase_start = trace_begin();
+			remote_poll();
+			trace_end(TRACE_EVENT_POLLING, phase_start);
+		}
+
+		phase_start = trace_begin();
+		uint64_t emulation_start = SDL_GetPerformanceCounter();
+		uint32_t cycles_run = 0;
+
+		chip8_process_key_events(emulation_start);
+
+		// run a 60th of a second worth of cycles per frame, carrying over the fraction
+		cycles_owed += myChip8.clock_rate / 60.0;
+		while ( cycles_owed >= 1 )
+		{
+			run_cycle(log_flag);
+			cycles_owed -= 1;
+			cycles_run++;
+		}
+
+		perf_record_emulation(cycles_run, SDL_GetPerformanceCounter() - emulation_start);
+		trace_end(TRACE_EMULATION, phase_start);
+
+		phase_start = trace_begin();
+
+		capture_frames();
+		remote_send_frame();
+
+		if (wav_path_arg)
+		{
+			// render every sample up to the cycle the emulation reached
+			uint64_t samples_due = myChip8.cycle_count * wav_sample_rate / myChip8.clock_rate;
+
+			while (samples_rendered < samples_due)
+			{
+				const uint64_t chunk = sizeof(samples) / sizeof(samples[0]);
+				int count = samples_due - samples_rendered < chunk ? samples_due - samples_rendered : chunk;
+
+				audio_render_offline(&synth, samples, count, myChip8.clock_rate);
+				if ( !wav_write(&wav, samples, count) )
+				{
+					printf("Cannot write wav file %s\n", wav_path_arg);
+					wav_close(&wav);
+					return EXIT_FAILURE;
+				}
+
+				samples_rendered += count;
+			}
+		}
+
+		trace_end(TRACE_FRAME_OUTPUT, phase_start);
+
+		perf_frame_end();
+	}
+
+	if (wav_path_arg)
+	{
+		if ( !wav_close(&wav) ) printf("Cannot finish wav file %s\n", wav_path_arg);
+		else printf("%.2f seconds of audio written to %s\n", (double) samples_rendered / wav_sample_rate, wav_path_arg);
+	}
+
+	PerfStats stats;
+	perf_get_stats(&stats);
+	perf_print_stats(&stats);
+
+	write_reports();
+	close_capture();
+	remote_close();
+
+	return EXIT_SUCCESS;
+}
+
+void write_reports()
+{
+	if (profile_path_arg && profiler_write_report(profile_path_arg)) printf("profile report written to %s\n", profile_path_arg);
+	if (flamegraph_path_arg && profiler_write_collapsed_stacks(flamegraph_path_arg)) printf("collapsed call stacks written to %s\n", flamegraph_path_arg);
+	if (trace_path_arg && trace_write_chrome_json(trace_path_arg)) printf("frame trace written to %s\n", trace_path_arg);
+}
+
+void capture_frames()
+{
+	if ( !capture_is_open() ) return;
+
+	// one frame per 60hz tick of emulated time, ticks passed within one batch of cycles repeat its last frame
+	while (frames_captured < myChip8.frame_count)
+	{
+		capture_frame();
+		frames_captured++;
+	}
+}
+
+void close_capture()
+{
+	if ( !capture_is_open() ) return;
+
+	capture_close();
+	printf("%llu frames captured to %s, %llu dropped\n", (unsigned long long) frames_captured, capture_path_arg, (unsigned long long) capture_get_dropped_frames());
+}
+
 void process_key_input_down(SDL_Event *e)
 {
+	// performance counter value used to measure latency until the emulator applies the key
+	uint64_t timestamp = SDL_GetPerformanceCounter();
+
 	switch ( e->key.keysym.scancode )
 	{
-		case SDL_SCANCODE_1: chip8_set_key_down(0x1); break;
-		case SDL_SCANCODE_2: chip8_set_key_down(0x2); break;
-		case SDL_SCANCODE_3: chip8_set_key_down(0x3); break;
-		case SDL_SCANCODE_4: chip8_set_key_down(0xC); break;
-		case SDL_SCANCODE_Q: chip8_set_key_down(0x4); break;
-		case SDL_SCANCODE_W: chip8_set_key_down(0x5); break;
-		case SDL_SCANCODE_E: chip8_set_key_down(0x6); break;
-		case SDL_SCANCODE_R: chip8_set_key_down(0xD); break;
-		case SDL_SCANCODE_A: chip8_set_key_down(0x7); break;
-		case SDL_SCANCODE_S: chip8_set_key_down(0x8); break;
-		case SDL_SCANCODE_D: chip8_set_key_down(0x9); break;
-		case SDL_SCANCODE_F: chip8_set_key_down(0xE); break;
-		case SDL_SCANCODE_Z: chip8_set_key_down(0xA); break;
-		case SDL_SCANCODE_X: chip8_set_key_down(0x0); break;
-		case SDL_SCANCODE_C: chip8_set_key_down(0xB); break;
-		case SDL_SCANCODE_V: chip8_set_key_down(0xF); break;
+		case SDL_SCANCODE_1: chip8_queue_key_event(0x1, true, timestamp); break;
+		case SDL_SCANCODE_2: chip8_queue_key_event(0x2, true, timestamp); break;
+		case SDL_SCANCODE_3: chip8_queue_key_event(0x3, true, timestamp); break;
+		case SDL_SCANCODE_4: chip8_queue_key_event(0xC, true, timestamp); break;
+		case SDL_SCANCODE_Q: chip8_queue_key_event(0x4, true, timestamp); break;
+		case SDL_SCANCODE_W: chip8_queue_key_event(0x5, true, timestamp); break;
+		case SDL_SCANCODE_E: chip8_queue_key_event(0x6, true, timestamp); break;
+		case SDL_SCANCODE_R: chip8_queue_key_event(0xD, true, timestamp); break;
+		case SDL_SCANCODE_A: chip8_queue_key_event(0x7, true, timestamp); break;
+		case SDL_SCANCODE_S: chip8_queue_key_event(0x8, true, timestamp); break;
+		case SDL_SCANCODE_D: chip8_queue_key_event(0x9, true, timestamp); break;
+		case SDL_SCANCODE_F: chip8_queue_key_event(0xE, true, timestamp); break;
+		case SDL_SCANCODE_Z: chip8_queue_key_event(0xA, true, timestamp); break;
+		case SDL_SCANCODE_X: chip8_queue_key_event(0x0, true, timestamp); break;
+		case SDL_SCANCODE_C: chip8_queue_key_event(0xB, true, timestamp); break;
+		case SDL_SCANCODE_V: chip8_queue_key_event(0xF, true, timestamp); break;
 		default: break;
 	}
 }
 
 void process_key_input_up(SDL_Event *e)
 {
+	// performance counter value used to measure latency until the emulator applies the key
+	uint64_t timestamp = SDL_GetPerformanceCounter();
+
 	switch ( e->key.keysym.scancode )
 	{
-		case SDL_SCANCODE_1: chip8_set_key_up(0x1); break;
-		case SDL_SCANCODE_2: chip8_set_key_up(0x2); break;
-		case SDL_SCANCODE_3: chip8_set_key_up(0x3); break;
-		case SDL_SCANCODE_4: chip8_set_key_up(0xC); break;
-		case SDL_SCANCODE_Q: chip8_set_key_up(0x4); break;
-		case SDL_SCANCODE_W: chip8_set_key_up(0x5); break;
-		case SDL_SCANCODE_E: chip8_set_key_up(0x6); break;
-		case SDL_SCANCODE_R: chip8_set_key_up(0xD); break;
-		case SDL_SCANCODE_A: chip8_set_key_up(0x7); break;
-		case SDL_SCANCODE_S: chip8_set_key_up(0x8); break;
-		case SDL_SCANCODE_D: chip8_set_key_up(0x9); break;
-		case SDL_SCANCODE_F: chip8_set_key_up(0xE); break;
-		case SDL_SCANCODE_Z: chip8_set_key_up(0xA); break;
-		case SDL_SCANCODE_X: chip8_set_key_up(0x0); break;
-		case SDL_SCANCODE_C: chip8_set_key_up(0xB); break;
-		case SDL_SCANCODE_V: chip8_set_key_up(0xF); break;
-		case SDL_SCANCODE_F5: 
-		{
-			myChip8.pause_flag = !myChip8.pause_flag;
-			if (myChip8.pause_flag)
-			{
-				printf("Paused, press space to step through a single instruction or press f5 again to resume.\n");
-				display_mute_volume(true); // mute audio when paused
-			}
-			else
-			{
-				display_mute_volume(false); // unmute audio when unpaused
-			}
-			break;
-		}
-		case SDL_SCANCODE_SPACE: 
-		{
-			if (myChip8.pause_flag) myChip8.cycle_step_flag = true; 
-			break;
-		}
+		case SDL_SCANCODE_1: chip8_queue_key_event(0x1, false, timestamp); break;
+		case SDL_SCANCODE_2: chip8_queue_key_event(0x2, false, timestamp); break;
+		case SDL_SCANCODE_3: chip8_queue_key_event(0x3, false, timestamp); break;
+		case SDL_SCANCODE_4: chip8_queue_key_event(0xC, false, timestamp); break;
+		case SDL_SCANCODE_Q: chip8_queue_key_event(0x4, false, timestamp); break;
+		case SDL_SCANCODE_W: chip8_queue_key_event(0x5, false, timestamp); break;
+		case SDL_SCANCODE_E: chip8_queue_key_event(0x6, false, timestamp); break;
+		case SDL_SCANCODE_R: chip8_queue_key_event(0xD, false, timestamp); break;
+		case SDL_SCANCODE_A: chip8_queue_key_event(0x7, false, timestamp); break;
+		case SDL_SCANCODE_S: chip8_queue_key_event(0x8, false, timestamp); break;
+		case SDL_SCANCODE_D: chip8_queue_key_event(0x9, false, timestamp); break;
+		case SDL_SCANCODE_F: chip8_queue_key_event(0xE, false, timestamp); break;
+		case SDL_SCANCODE_Z: chip8_queue_key_event(0xA, false, timestamp); break;
+		case SDL_SCANCODE_X: chip8_queue_key_event(0x0, false, timestamp); break;
+		case SDL_SCANCODE_C: chip8_queue_key_event(0xB, false, timestamp); break;
+		case SDL_SCANCODE_V: chip8_queue_key_event(0xF, false, timestamp); break;
+		case SDL_SCANCODE_F5: debugger_push_command(COMMAND_TOGGLE_PAUSE, 0); break;
+		case SDL_SCANCODE_F6: step_emulation_speed(-1); break;
+		case SDL_SCANCODE_F7: step_emulation_speed(1); break;
+		case SDL_SCANCODE_SPACE: debugger_push_command(COMMAND_CYCLE_STEP, 0); break;
 		default: break;
 	}
 }
@@ -189,10 +569,10 @@ bool process_command_line_args(int argc, char *argv[])
 {
 	extern char *optarg;
 	int option;
-	int clock_rate_flag = 0, display_scale_flag = 0, rom_path_flag = 0;
-	const char *clock_rate_arg = NULL, *display_scale_arg = NULL;
+	int clock_rate_flag = 0, display_scale_flag = 0, rom_path_flag = 0, gui_refresh_rate_flag = 0, sample_interval_flag = 0, headless_frames_flag = 0, quirk_profile_flag = 0, audio_buffer_size_flag = 0, wav_sample_rate_flag = 0, capture_scale_flag = 0, run_ahead_flag = 0, emulation_speed_flag = 0;
+	const char *clock_rate_arg = NULL, *display_scale_arg = NULL, *gui_refresh_rate_arg = NULL, *sample_interval_arg = NULL, *headless_frames_arg = NULL, *quirk_profile_arg = NULL, *audio_buffer_size_arg = NULL, *wav_sample_rate_arg = NULL, *capture_scale_arg = NULL, *run_ahead_arg = NULL, *emulation_speed_arg = NULL;
 
-	while ( ( option = getopt(argc, argv, "c:d:p:lg") ) != -1 )
+	while ( ( option = getopt(argc, argv, "c:d:p:r:P:F:n:t:H:q:D:b:w:a:v:V:u:k:s:lg") ) != -1 )
 	{
 		switch ( option )
 		{
@@ -214,6 +594,67 @@ bool process_command_line_args(int argc, char *argv[])
 				rom_path_arg = optarg;
 				break;
 			}
+			case 'r':
+			{
+				gui_refresh_rate_flag = 1;
+				gui_refresh_rate_arg = optarg;
+				break;
+			}
+			case 'P': profile_path_arg = optarg; break;
+			case 'F': flamegraph_path_arg = optarg; break;
+			case 't': trace_path_arg = optarg; break;
+			case 'H':
+			{
+				headless_frames_flag = 1;
+				headless_frames_arg = optarg;
+				break;
+			}
+			case 'n':
+			{
+				sample_interval_flag = 1;
+				sample_interval_arg = optarg;
+				break;
+			}
+			case 'q':
+			{
+				quirk_profile_flag = 1;
+				quirk_profile_arg = optarg;
+				break;
+			}
+			case 'D': rom_database_arg = optarg; break;
+			case 'b':
+			{
+				audio_buffer_size_flag = 1;
+				audio_buffer_size_arg = optarg;
+				break;
+			}
+			case 'w': wav_path_arg = optarg; break;
+			case 'a':
+			{
+				wav_sample_rate_flag = 1;
+				wav_sample_rate_arg = optarg;
+				break;
+			}
+			case 'v': capture_path_arg = optarg; break;
+			case 'u': remote_socket_arg = optarg; break;
+			case 'V':
+			{
+				capture_scale_flag = 1;
+				capture_scale_arg = optarg;
+				break;
+			}
+			case 'k':
+			{
+				run_ahead_flag = 1;
+				run_ahead_arg = optarg;
+				break;
+			}
+			case 's':
+			{
+				emulation_speed_flag = 1;
+				emulation_speed_arg = optarg;
+				break;
+			}
 			case 'g':
 			{
 				gui_flag = false;
@@ -222,10 +663,26 @@ bool process_command_line_args(int argc, char *argv[])
 			case 'l': log_flag = true; break;
 			default:
 			{
-				printf("Usage: chip8.exe [-p] [-c] [-d] [-l] [-g]\n");
+				printf("Usage: chip8.exe [-p] [-c] [-d] [-r] [-P] [-F] [-n] [-t] [-H] [-q] [-D] [-b] [-w] [-a] [-v] [-V] [-u] [-k] [-s] [-l] [-g]\n");
 				printf("\t -p sets the path to the rom to run, is a required argument\n");
-				printf("\t -c optional, set the clock rate to value between 1 - 2000 hz, defaults to %d hz\n", DEFAULT_CLOCK_RATE);
+				printf("\t -c optional, set the clock rate to value between %d - %d hz, defaults to %d hz\n", MIN_CLOCK_RATE, MAX_CLOCK_RATE, DEFAULT_CLOCK_RATE);
 				printf("\t -d optional, sets the display scale size, defaults to %d\n", display_scale);
+				printf("\t -r optional, sets how many times per second the gui is refreshed, defaults to %d hz\n", GUI_DEFAULT_REFRESH_RATE);
+				printf("\t -P optional, counts executions per address and opcode and writes a sorted report to the given file on exit\n");
+				printf("\t -F optional, samples the guest call stack and writes it in collapsed stack format for flamegraph tools to the given file on exit\n");
+				printf("\t -n optional, number of instructions between call stack samples, defaults to %d\n", PROFILER_DEFAULT_SAMPLE_INTERVAL);
+				printf("\t -t optional, times each phase of the main loop or headless run and writes them as chrome trace json to the given file on exit\n");
+				printf("\t -H optional, runs the given number of frames without a window as fast as possible and prints performance stats\n");
+				printf("\t -q optional, selects the quirk profile of the variant the rom was written for: default, vip, schip or xochip, defaults to default\n");
+				printf("\t -D optional, sets the quirk profile, clock rate and colors from the entry of the rom in the given rom database, -c and -q take precedence\n");
+				printf("\t -b optional, sets the audio buffer size between %d - %d samples, smaller buffers lower the audio latency, defaults to %d\n", MIN_AUDIO_BUFFER_SIZE, MAX_AUDIO_BUFFER_SIZE, DEFAULT_AUDIO_BUFFER_SIZE);
+				printf("\t -w optional, renders the audio of a headless run into the given wav file\n");
+				printf("\t -a optional, sets the sample rate of the wav file between 8000 - 192000 hz, defaults to %d hz\n", SAMPLES_PER_SEC);
+				printf("\t -v optional, captures every emulated frame to the given y4m file, to stdout as y4m for -, or to numbered images for a .png path\n");
+				printf("\t -V optional, sets the capture scale between 1 - %d times the 64 by 32 display, defaults to %d\n", MAX_CAPTURE_SCALE, DEFAULT_CAPTURE_SCALE);
+				printf("\t -u optional, serves the display to remote viewers and takes their keys on a unix socket created at the given path, paces headless runs to real time\n");
+				printf("\t -k optional, shows the display the given number of frames between 1 - %d ahead of the emulation to hide the input lag of the rom\n", MAX_RUN_AHEAD_FRAMES);
+				printf("\t -s optional, runs the window at the given speed between %g - %g times real time, or as fast as possible for max, F6 and F7 change it while running, defaults to 1\n", MIN_EMULATION_SPEED, MAX_EMULATION_SPEED);
 				printf("\t -l optional, enables the disassembler logs to the console\n");
 				printf("\t -g optional, toggles the gui off\n");
 				return false;
@@ -241,16 +698,146 @@ bool process_command_line_args(int argc, char *argv[])
 
 	if (clock_rate_flag == 1) 
 	{
-		myChip8.clock_rate = atoi(clock_rate_arg);
+		clock_rate = atoi(clock_rate_arg);
 
-		if (myChip8.clock_rate > 2000 || myChip8.clock_rate < 1)
+		if (clock_rate > MAX_CLOCK_RATE || clock_rate < MIN_CLOCK_RATE)
 		{
-			printf("Clock rate is limited between 1 - 2000 hz!\n");
+			printf("Clock rate is limited between %d - %d hz!\n", MIN_CLOCK_RATE, MAX_CLOCK_RATE);
 			return false;
 		}
 	}
 
 	if (display_scale_flag == 1) display_scale = atoi(display_scale_arg);
 
+	if (gui_refresh_rate_flag == 1)
+	{
+		gui_refresh_rate = atoi(gui_refresh_rate_arg);
+
+		if (gui_refresh_rate < 1 || gui_refresh_rate > 240)
+		{
+			printf("Gui refresh rate is limited between 1 - 240 hz!\n");
+			return false;
+		}
+	}
+
+	if (sample_interval_flag == 1)
+	{
+		int interval = atoi(sample_interval_arg);
+
+		if (interval < 1)
+		{
+			printf("Call stack sample interval must be at least 1 instruction!\n");
+			return false;
+		}
+
+		sample_interval = interval;
+	}
+
+	if (quirk_profile_flag == 1)
+	{
+		if ( !chip8_find_quirk_profile(quirk_profile_arg, &quirk_profile) )
+		{
+			printf("Unknown quirk profile %s, must be one of default, vip, schip or xochip!\n", quirk_profile_arg);
+			return false;
+		}
+
+		quirk_profile_given = true;
+	}
+
+	if (audio_buffer_size_flag == 1)
+	{
+		audio_buffer_size = atoi(audio_buffer_size_arg);
+
+		if (audio_buffer_size < MIN_AUDIO_BUFFER_SIZE || audio_buffer_size > MAX_AUDIO_BUFFER_SIZE)
+		{
+			printf("Audio buffer size is limited between %d - %d samples!\n", MIN_AUDIO_BUFFER_SIZE, MAX_AUDIO_BUFFER_SIZE);
+			return false;
+		}
+	}
+
+	if (headless_frames_flag == 1)
+	{
+		int frames = atoi(headless_frames_arg);
+
+		if (frames < 1)
+		{
+			printf("Headless runs need at least 1 frame!\n");
+			return false;
+		}
+
+		headless_frames = frames;
+	}
+
+	if (wav_path_arg && headless_frames == 0)
+	{
+		printf("Rendering audio to a wav file needs a headless run [-H frames]!\n");
+		return false;
+	}
+
+	if (capture_scale_flag == 1)
+	{
+		capture_scale = atoi(capture_scale_arg);
+
+		if (capture_scale < 1 || capture_scale > MAX_CAPTURE_SCALE)
+		{
+			printf("Capture scale is limited between 1 - %d!\n", MAX_CAPTURE_SCALE);
+			return false;
+		}
+	}
+
+	if (run_ahead_flag == 1)
+	{
+		int frames = atoi(run_ahead_arg);
+
+		if (frames < 1 || frames > MAX_RUN_AHEAD_FRAMES)
+		{
+			printf("Run ahead is limited between 1 - %d frames!\n", MAX_RUN_AHEAD_FRAMES);
+			return false;
+		}
+
+		if (headless_frames > 0)
+		{
+			printf("Run ahead only applies to the window, not to headless runs!\n");
+			return false;
+		}
+
+		run_ahead_frames = frames;
+	}
+
+	if (emulation_speed_flag == 1)
+	{
+		if (strcmp(emulation_speed_arg, "max") == 0)
+		{
+			emulation_speed = 0;
+		}
+		else
+		{
+			emulation_speed = atof(emulation_speed_arg);
+
+			if (emulation_speed < MIN_EMULATION_SPEED || emulation_speed > MAX_EMULATION_SPEED)
+			{
+				printf("Emulation speed is limited between %g - %g times, or max!\n", MIN_EMULATION_SPEED, MAX_EMULATION_SPEED);
+				return false;
+			}
+		}
+
+		if (headless_frames > 0)
+		{
+			printf("Emulation speed only applies to the window, headless runs always run as fast as possible!\n");
+			return false;
+		}
+	}
+
+	if (wav_sample_rate_flag == 1)
+	{
+		wav_sample_rate = atoi(wav_sample_rate_arg);
+
+		if (wav_sample_rate < 8000 || wav_sample_rate > 192000)
+		{
+			printf("Wav sample rate is limited between 8000 - 192000 hz!\n");
+			return false;
+		}
+	}
+
 	return true;
 }
\ No newline at end of file
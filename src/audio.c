@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include "SDL.h"
+
+#include "../includes/audio.h"
+#include "../includes/chip8.h"
+#include "../includes/perf.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+_Static_assert(SOUND_PATTERN_SIZE == AUDIO_PATTERN_SIZE, "sound events must carry a whole audio pattern");
+
+static SDL_AudioDeviceID device_id = 0;
+
+// generator used by the audio device, only touched by the audio callback once the device runs
+static AudioSynth device_synth;
+
+// beep start and stop events from the emulation waiting to be rendered
+static SoundQueue sound_queue;
+
+// kinds of event that replace each other, a start or stop, a pitch and a pattern
+#define PENDING_KINDS 3
+
+// events that did not fit into a full queue, only the newest of each kind is kept as it decides the state
+// they are pushed in cycle order before any newer event, only touched by the emulation thread
+static SoundEvent pending_events[PENDING_KINDS];
+static bool event_pending[PENDING_KINDS];
+
+// written by the emulation and gui threads, read once per buffer by the audio callback
+static atomic_uint_fast64_t sync_cycle = 0;
+static atomic_uint sync_clock_rate = 0;
+static atomic_int volume = DEFAULT_VOLUME;
+static _Atomic double speed = 1.0;
+
+// callback for sdl to use for generating sound
+static void audio_callback(void* userdata, uint8_t* stream, int streamSize)
+{
+   int16_t *audioBuffer = (int16_t*) stream;
+   int audioBufferLength = streamSize / 2; // streamSize in bytes divide by 2 for length of 16 bit int array
+
+   perf_audio_callback(audioBufferLength, device_synth.sample_rate);
+
+   uint64_t emulated_cycle = atomic_load_explicit(&sync_cycle, memory_order_acquire);
+   double emulation_speed = atomic_load_explicit(&speed, memory_order_relaxed);
+
+   // cycles the emulation runs per second of real time, unknown when uncapped so the rate is kept and every buffer resyncs
+   double clock_rate = atomic_load_explicit(&sync_clock_rate, memory_order_relaxed) * ( emulation_speed > 0 ? emulation_speed : 1.0 );
+   double cycles_per_sample = clock_rate / device_synth.sample_rate;
+
+   // the emulation runs a frame of cycles at a time and reports progress every 60th of a second
+   // so render two frames plus this buffer behind it, by then every event of the buffer is queued
+   // drift from pauses, hitches or a changed clock rate is corrected by jumping straight to the target
+   double target = (double) emulated_cycle - audioBufferLength * cycles_per_sample - clock_rate / 30.0;
+   if ( fabs(device_synth.cycle - target) > clock_rate / 10.0 || emulation_speed == 0 ) device_synth.cycle = target;
+
+   // fast forwarded beeps would only be clicks, they are still rendered to keep the queue drained
+   bool muted = emulation_speed > 1.0 || emulation_speed == 0;
+
+   audio_synth_render(&device_synth, &sound_queue, audioBuffer, audioBufferLength, cycles_per_sample, muted ? 0 : atomic_load_explicit(&volume, memory_order_relaxed));
+}
+
+// the pattern is played at 4000 bits per second at the default pitch, 48 pitch steps per octave
+static void set_pattern_pitch(AudioSynth *synth, uint8_t pitch)
+{
+   synth->pattern_step = 4000 * pow(2, ( pitch - DEFAULT_PITCH ) / 48.0) / synth->sample_rate;
+}
+
+static void apply_event(AudioSynth *synth, const SoundEvent *event)
+{
+   switch (event->type)
+   {
+      case SOUND_STOP: synth->sound_on = false; break;
+      case SOUND_START: synth->sound_on = true; break;
+      case SOUND_PITCH: set_pattern_pitch(synth, event->pitch); break;
+      case SOUND_PATTERN:
+      {
+         memcpy(synth->pattern, event->pattern, SOUND_PATTERN_SIZE);
+         synth->pattern_loaded = true;
+         break;
+      }
+   }
+}
+
+void audio_synth_init(AudioSynth *synth, int sample_rate)
+{
+   synth->sample_rate = sample_rate;
+   synth->cycle = 0;
+   synth->sound_on = false;
+   synth->phase = 0;
+   synth->phase_step = (uint32_t) ( (double) FREQUENCY / sample_rate * 4294967296.0 );
+   synth->pattern_loaded = false;
+   synth->pattern_position = 0;
+   set_pattern_pitch(synth, DEFAULT_PITCH);
+   synth->gain = 0;
+   synth->gain_step = 1000.0f / ( ENVELOPE_MS * sample_rate );
+
+   // sum the odd harmonics of the square wave below the nyquist frequency
+   // each is scaled by a lanczos sigma factor to smooth out the ringing at the edges
+   int harmonics = ( sample_rate / 2 ) / FREQUENCY;
+   float peak = 0;
+
+   for (int i = 0; i < WAVETABLE_SIZE; ++i)
+   {
+      double angle = 2 * M_PI * i / WAVETABLE_SIZE;
+      double sample = 0;
+
+      for (int harmonic = 1; harmonic <= harmonics; harmonic += 2)
+      {
+         double x = M_PI * harmonic / ( harmonics + 1 );
+         sample += sin(harmonic * angle) / harmonic * ( sin(x) / x );
+      }
+
+      synth->wavetable[i] = sample;
+      if (fabs(sample) > peak) peak = fabs(sample);
+   }
+
+   for (int i = 0; i < WAVETABLE_SIZE; ++i) synth->wavetable[i] /= peak;
+}
+
+void audio_synth_render(AudioSynth *synth, SoundQueue *queue, int16_t *samples, int count, double cycles_per_sample, int volume)
+{
+   SoundEvent event;
+   bool event_pending = sound_queue_peek(queue, &event);
+
+   // skip the work entirely while silent until the next beep
+   double end_cycle = synth->cycle + count * cycles_per_sample;
+   if ( synth->gain == 0 && !synth->sound_on && !( event_pending && event.cycle < end_cycle ) )
+   {
+      for (int i = 0; i < count; ++i) samples[i] = 0;
+      synth->cycle = end_cycle;
+      return;
+   }
+
+   for (int i = 0; i < count; ++i)
+   {
+      // apply every event due by this sample
+      while ( event_pending && event.cycle <= synth->cycle )
+      {
+         apply_event(synth, &event);
+         sound_queue_pop(queue, &event);
+         event_pending = sound_queue_peek(queue, &event);
+      }
+      synth->cycle += cycles_per_sample;
+
+      float target = synth->sound_on ? 1.0f : 0.0f;
+
+      // ramp the envelope towards the target so the wave never starts or stops abruptly
+      if (synth->gain < target)
+      {
+         synth->gain += synth->gain_step;
+         if (synth->gain > target) synth->gain = target;
+      }
+      else if (synth->gain > target)
+      {
+         synth->gain -= synth->gain_step;
+         if (synth->gain < target) synth->gain = target;
+      }
+
+      float wave;
+
+      // xo-chip programs play their own 1 bit pattern instead of the beep
+      if (synth->pattern_loaded)
+      {
+         int bit = (int) synth->pattern_position;
+         wave = ( synth->pattern[bit / 8] >> ( 7 - bit % 8 ) ) & 1 ? 1.0f : -1.0f;
+
+         synth->pattern_position += synth->pattern_step;
+         if (synth->pattern_position >= AUDIO_PATTERN_SIZE * 8) synth->pattern_position -= AUDIO_PATTERN_SIZE * 8;
+      }
+      else
+      {
+         wave = synth->wavetable[synth->phase >> ( 32 - WAVETABLE_BITS )];
+         synth->phase += synth->phase_step;
+      }
+
+      samples[i] = (int16_t) ( wave * synth->gain * volume );
+   }
+}
+
+bool audio_init(int buffer_size)
+{
+   SDL_AudioSpec want, have;
+
+   SDL_memset( &want, 0, sizeof( want ) );
+   want.freq = SAMPLES_PER_SEC;
+   want.format = AUDIO_S16SYS;
+   want.channels = 1;
+   want.samples = buffer_size;
+   want.callback = audio_callback;
+   want.userdata = NULL;
+   
+   // attempt to open audio device, error if it returns 0
+   if ( ( device_id = SDL_OpenAudioDevice(NULL, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE) ) == 0 )
+   {
+      printf("SDL could not get an audio device! SDL Error: %s\n", SDL_GetError());
+      return false;
+   }
+   
+   if (have.format != AUDIO_S16SYS || have.channels != 1)
+   {
+      printf("SDL could not get desired audio format! SDL Error: %s\n", SDL_GetError());
+      return false;
+   }
+
+   audio_synth_init(&device_synth, have.freq);
+   sound_queue_init(&sound_queue);
+   for (int kind = 0; kind < PENDING_KINDS; ++kind) event_pending[kind] = false;
+
+   // the device runs for the whole session, the beep is switched on and off inside the callback
+   perf_audio_restart();
+   SDL_PauseAudioDevice(device_id, 0);
+
+   return true;
+}
+
+void audio_close()
+{
+   if (device_id) SDL_CloseAudioDevice(device_id);
+   device_id = 0;
+}
+
+static int pending_kind(uint8_t type)
+{
+   switch (type)
+   {
+      case SOUND_PITCH: return 1;
+      case SOUND_PATTERN: return 2;
+      default: return 0;
+   }
+}
+
+// push the pending events oldest first until the queue is full again, returns true once none are left
+static bool flush_pending_events()
+{
+   for (;;)
+   {
+      int oldest = -1;
+
+      for (int kind = 0; kind < PENDING_KINDS; ++kind)
+      {
+         if ( event_pending[kind] && ( oldest < 0 || pending_events[kind].cycle < pending_events[oldest].cycle ) ) oldest = kind;
+      }
+
+      if (oldest < 0) return true;
+      if ( !sound_queue_push(&sound_queue, pending_events[oldest]) ) return false;
+
+      event_pending[oldest] = false;
+   }
+}
+
+// events keep their order, one that does not fit is held back and replaces an older held back one of its kind
+static void queue_event(const SoundEvent *event)
+{
+   if ( flush_pending_events() && sound_queue_push(&sound_queue, *event) ) return;
+
+   int kind = pending_kind(event->type);
+   pending_events[kind] = *event;
+   event_pending[kind] = true;
+}
+
+void audio_queue_sound_event(uint64_t cycle, bool on)
+{
+   SoundEvent event = { .cycle = cycle, .type = on ? SOUND_START : SOUND_STOP };
+   queue_event(&event);
+}
+
+void audio_queue_pattern_event(uint64_t cycle, const uint8_t *pattern)
+{
+   SoundEvent event = { .cycle = cycle, .type = SOUND_PATTERN };
+   memcpy(event.pattern, pattern, SOUND_PATTERN_SIZE);
+   queue_event(&event);
+}
+
+void audio_queue_pitch_event(uint64_t cycle, uint8_t pitch)
+{
+   SoundEvent event = { .cycle = cycle, .type = SOUND_PITCH, .pitch = pitch };
+   queue_event(&event);
+}
+
+void audio_sync(uint64_t cycle, uint32_t clock_rate)
+{
+   // held back events go out as soon as the renderer has made room for them
+   flush_pending_events();
+
+   atomic_store_explicit(&sync_clock_rate, clock_rate, memory_order_relaxed);
+   atomic_store_explicit(&sync_cycle, cycle, memory_order_release);
+}
+
+void audio_render_offline(AudioSynth *synth, int16_t *samples, int count, uint32_t clock_rate)
+{
+   audio_synth_render(synth, &sound_queue, samples, count, (double) clock_rate / synth->sample_rate, atomic_load_explicit(&volume, memory_order_relaxed));
+}
+
+void audio_set_speed(double emulation_speed)
+{
+   atomic_store_explicit(&speed, emulation_speed, memory_order_relaxed);
+}
+
+void audio_set_volume(int vol)
+{
+   if ( vol >= 0 )
+   {
+      atomic_store_explicit(&volume, vol, memory_order_relaxed);
+   } 
+}
+
+void audio_mute_volume(bool mute_flag)
+{
+   // save value of volume before muting
+   static int volume_before_mute = DEFAULT_VOLUME;
+
+   if (mute_flag)
+   {
+      volume_before_mute = atomic_exchange_explicit(&volume, 0, memory_order_relaxed);
+   }
+   else
+   {
+      atomic_store_explicit(&volume, volume_before_mute, memory_order_relaxed);
+   }
+}
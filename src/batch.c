@@ -0,0 +1,773 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../includes/batch.h"
+
+// lanes are grouped by a 0xFF or 0x00 byte mask, so that masked loops become vector blends instead of branches
+
+static void free_fields(Chip8Batch *batch)
+{
+   for (int x = 0; x < V_REGISTERS; ++x) free(batch->V[x]);
+   for (int level = 0; level < MAX_STACK_LEVEL; ++level) free(batch->stack[level]);
+
+   free(batch->I);
+   free(batch->PC);
+   free(batch->sp);
+   free(batch->delay_timer);
+   free(batch->sound_timer);
+   free(batch->keypad);
+   free(batch->pressed_key);
+   free(batch->key_released);
+   free(batch->random_state);
+   free(batch->halted);
+   free(batch->ram);
+   free(batch->framebuffers);
+   free(batch->memory_hash);
+   free(batch->rom);
+   free(batch->opcode);
+   free(batch->pending);
+   free(batch->mask);
+   free(batch->order);
+   free(batch->bucket_end);
+   free(batch->bucket_pcs);
+   free(batch->group_keys);
+}
+
+// positions of the words of a lane state hashed by batch_hash_lane, ram first
+#define HASH_FRAMEBUFFER ( BATCH_RAM_SIZE / 8 )
+#define HASH_V ( HASH_FRAMEBUFFER + BATCH_PIXELS_H )
+#define HASH_STACK ( HASH_V + V_REGISTERS / 8 )
+#define HASH_REGISTERS ( HASH_STACK + MAX_STACK_LEVEL / 4 )
+#define HASH_INPUT ( HASH_REGISTERS + 1 )
+
+uint64_t batch_hash_word(uint64_t position, uint64_t word)
+{
+   // murmur3 finalizer over the word salted with its position
+   uint64_t hash = word ^ ( position * 0x9E3779B97F4A7C15 );
+   hash ^= hash >> 33;
+   hash *= 0xFF51AFD7ED558CCD;
+   hash ^= hash >> 33;
+   hash *= 0xC4CEB9FE1A85EC53;
+   hash ^= hash >> 33;
+   return hash;
+}
+
+// recompute the ram and framebuffer terms of the fingerprint of lane
+static void hash_memory(Chip8Batch *batch, int lane)
+{
+   const uint8_t *ram = batch->ram + (size_t) lane * BATCH_RAM_SIZE;
+   const uint64_t *rows = batch->framebuffers + (size_t) lane * BATCH_PIXELS_H;
+   uint64_t hash = 0, word;
+
+   for (int position = 0; position < HASH_FRAMEBUFFER; ++position)
+   {
+      memcpy(&word, ram + position * 8, 8);
+      hash += batch_hash_word(position, word);
+   }
+
+   for (int row = 0; row < BATCH_PIXELS_H; ++row) hash += batch_hash_word(HASH_FRAMEBUFFER + row, rows[row]);
+
+   batch->memory_hash[lane] = hash;
+}
+
+// every write to ram goes through here to keep memory_hash up to date
+static void write_ram(Chip8Batch *batch, int lane, uint16_t address, uint8_t value)
+{
+   uint8_t *ram = batch->ram + (size_t) lane * BATCH_RAM_SIZE;
+   address &= BATCH_RAM_SIZE - 1;
+
+   if (ram[address] == value) return;
+
+   uint8_t *word_start = ram + ( address & ~7 );
+   uint64_t word;
+
+   memcpy(&word, word_start, 8);
+   batch->memory_hash[lane] -= batch_hash_word(address / 8, word);
+
+   ram[address] = value;
+
+   memcpy(&word, word_start, 8);
+   batch->memory_hash[lane] += batch_hash_word(address / 8, word);
+}
+
+// same for the framebuffer rows
+static void write_row(Chip8Batch *batch, int lane, int row, uint64_t bits)
+{
+   uint64_t *word = batch->framebuffers + (size_t) lane * BATCH_PIXELS_H + row;
+
+   if (*word == bits) return;
+
+   batch->memory_hash[lane] += batch_hash_word(HASH_FRAMEBUFFER + row, bits) - batch_hash_word(HASH_FRAMEBUFFER + row, *word);
+   *word = bits;
+}
+
+Chip8Batch *batch_create(int count, const uint8_t *rom, int rom_size, uint32_t seed)
+{
+   if (count < 1 || rom_size < 1 || rom_size > BATCH_RAM_SIZE - PROGRAM_START) return NULL;
+
+   Chip8Batch *batch = calloc(1, sizeof *batch);
+   if (!batch) return NULL;
+
+   batch->count = count;
+   batch->cycles_per_frame = DEFAULT_CLOCK_RATE / 60;
+
+   bool allocated = true;
+   for (int x = 0; x < V_REGISTERS; ++x) allocated &= ( batch->V[x] = calloc(count, 1) ) != NULL;
+   for (int level = 0; level < MAX_STACK_LEVEL; ++level) allocated &= ( batch->stack[level] = calloc(count, sizeof(uint16_t)) ) != NULL;
+
+   allocated &= ( batch->I = calloc(count, sizeof(uint16_t)) ) != NULL;
+   allocated &= ( batch->PC = calloc(count, sizeof(uint16_t)) ) != NULL;
+   allocated &= ( batch->sp = calloc(count, 1) ) != NULL;
+   allocated &= ( batch->delay_timer = calloc(count, 1) ) != NULL;
+   allocated &= ( batch->sound_timer = calloc(count, 1) ) != NULL;
+   allocated &= ( batch->keypad = calloc(count, sizeof(uint16_t)) ) != NULL;
+   allocated &= ( batch->pressed_key = calloc(count, 1) ) != NULL;
+   allocated &= ( batch->key_released = calloc(count, 1) ) != NULL;
+   allocated &= ( batch->random_state = calloc(count, sizeof(uint32_t)) ) != NULL;
+   allocated &= ( batch->halted = calloc(count, 1) ) != NULL;
+   allocated &= ( batch->ram = calloc(count, BATCH_RAM_SIZE) ) != NULL;
+   allocated &= ( batch->framebuffers = calloc(count, BATCH_PIXELS_H * sizeof(uint64_t)) ) != NULL;
+   allocated &= ( batch->memory_hash = calloc(count, sizeof(uint64_t)) ) != NULL;
+   allocated &= ( batch->rom = malloc(rom_size) ) != NULL;
+   allocated &= ( batch->opcode = calloc(count, sizeof(uint16_t)) ) != NULL;
+   allocated &= ( batch->pending = calloc(count, 1) ) != NULL;
+   allocated &= ( batch->mask = calloc(count, 1) ) != NULL;
+   allocated &= ( batch->order = calloc(count, sizeof(int)) ) != NULL;
+   allocated &= ( batch->bucket_end = calloc(BATCH_RAM_SIZE, sizeof(int)) ) != NULL;
+   allocated &= ( batch->bucket_pcs = calloc(count, sizeof(uint16_t)) ) != NULL;
+   allocated &= ( batch->group_keys = calloc(count, sizeof(uint64_t)) ) != NULL;
+
+   if (!allocated)
+   {
+      batch_destroy(batch);
+      return NULL;
+   }
+
+   memcpy(batch->rom, rom, rom_size);
+   batch->rom_size = rom_size;
+
+   for (int lane = 0; lane < count; ++lane) batch_reset_lane(batch, lane, seed);
+
+   return batch;
+}
+
+void batch_destroy(Chip8Batch *batch)
+{
+   if (!batch) return;
+
+   free_fields(batch);
+   free(batch);
+}
+
+void batch_reset_lane(Chip8Batch *batch, int lane, uint32_t seed)
+{
+   for (int x = 0; x < V_REGISTERS; ++x) batch->V[x][lane] = 0;
+   for (int level = 0; level < MAX_STACK_LEVEL; ++level) batch->stack[level][lane] = 0;
+
+   batch->I[lane] = 0;
+   batch->PC[lane] = PROGRAM_START;
+   batch->sp[lane] = 0;
+   batch->delay_timer[lane] = 0;
+   batch->sound_timer[lane] = 0;
+   batch->keypad[lane] = 0;
+   batch->pressed_key[lane] = 0;
+   batch->key_released[lane] = 0;
+   batch->halted[lane] = 0;
+
+   // give every lane its own sequence, xorshift state must never be 0
+   uint32_t state = seed ^ ( (uint32_t) lane * 0x9E3779B9 );
+   batch->random_state[lane] = state ? state : 1;
+
+   uint8_t *ram = batch->ram + (size_t) lane * BATCH_RAM_SIZE;
+   memset(ram, 0, BATCH_RAM_SIZE);
+   memcpy(ram + FONT_START, chip8_font, FONT_SIZE);
+   memcpy(ram + PROGRAM_START, batch->rom, batch->rom_size);
+
+   memset(batch->framebuffers + (size_t) lane * BATCH_PIXELS_H, 0, BATCH_PIXELS_H * sizeof(uint64_t));
+
+   hash_memory(batch, lane);
+}
+
+void batch_save_lane(const Chip8Batch *batch, int lane, BatchLaneState *state)
+{
+   for (int x = 0; x < V_REGISTERS; ++x) state->V[x] = batch->V[x][lane];
+   for (int level = 0; level < MAX_STACK_LEVEL; ++level) state->stack[level] = batch->stack[level][lane];
+
+   state->I = batch->I[lane];
+   state->PC = batch->PC[lane];
+   state->sp = batch->sp[lane];
+   state->delay_timer = batch->delay_timer[lane];
+   state->sound_timer = batch->sound_timer[lane];
+   state->keypad = batch->keypad[lane];
+   state->pressed_key = batch->pressed_key[lane];
+   state->key_released = batch->key_released[lane];
+   state->random_state = batch->random_state[lane];
+   state->halted = batch->halted[lane];
+
+   memcpy(state->ram, batch->ram + (size_t) lane * BATCH_RAM_SIZE, BATCH_RAM_SIZE);
+   memcpy(state->framebuffer, batch->framebuffers + (size_t) lane * BATCH_PIXELS_H, sizeof state->framebuffer);
+   state->memory_hash = batch->memory_hash[lane];
+}
+
+void batch_load_lane(Chip8Batch *batch, int lane, const BatchLaneState *state)
+{
+   for (int x = 0; x < V_REGISTERS; ++x) batch->V[x][lane] = state->V[x];
+   for (int level = 0; level < MAX_STACK_LEVEL; ++level) batch->stack[level][lane] = state->stack[level];
+
+   batch->I[lane] = state->I;
+   batch->PC[lane] = state->PC;
+   batch->sp[lane] = state->sp;
+   batch->delay_timer[lane] = state->delay_timer;
+   batch->sound_timer[lane] = state->sound_timer;
+   batch->keypad[lane] = state->keypad;
+   batch->pressed_key[lane] = state->pressed_key;
+   batch->key_released[lane] = state->key_released;
+   batch->random_state[lane] = state->random_state;
+   batch->halted[lane] = state->halted;
+
+   memcpy(batch->ram + (size_t) lane * BATCH_RAM_SIZE, state->ram, BATCH_RAM_SIZE);
+   memcpy(batch->framebuffers + (size_t) lane * BATCH_PIXELS_H, state->framebuffer, sizeof state->framebuffer);
+   batch->memory_hash[lane] = state->memory_hash;
+}
+
+uint64_t batch_hash_lane(const Chip8Batch *batch, int lane)
+{
+   uint64_t hash = batch->memory_hash[lane], word;
+
+   for (int position = 0; position < V_REGISTERS / 8; ++position)
+   {
+      word = 0;
+      for (int x = 0; x < 8; ++x) word |= (uint64_t) batch->V[position * 8 + x][lane] << ( 8 * x );
+      hash += batch_hash_word(HASH_V + position, word);
+   }
+
+   for (int position = 0; position < MAX_STACK_LEVEL / 4; ++position)
+   {
+      word = 0;
+      for (int level = 0; level < 4; ++level) word |= (uint64_t) batch->stack[position * 4 + level][lane] << ( 16 * level );
+      hash += batch_hash_word(HASH_STACK + position, word);
+   }
+
+   word = batch->I[lane] | (uint64_t) batch->PC[lane] << 16 | (uint64_t) batch->sp[lane] << 32 |
+      (uint64_t) batch->delay_timer[lane] << 40 | (uint64_t) batch->sound_timer[lane] << 48 | (uint64_t) batch->halted[lane] << 56;
+   hash += batch_hash_word(HASH_REGISTERS, word);
+
+   word = batch->keypad[lane] | (uint64_t) batch->pressed_key[lane] << 16 | (uint64_t) batch->key_released[lane] << 24 |
+      (uint64_t) batch->random_state[lane] << 32;
+   hash += batch_hash_word(HASH_INPUT, word);
+
+   return hash;
+}
+
+void batch_set_keypads(Chip8Batch *batch, const uint16_t *keypads)
+{
+   for (int lane = 0; lane < batch->count; ++lane)
+   {
+      uint16_t pressed = keypads[lane] & ~batch->keypad[lane];
+      uint16_t released = batch->keypad[lane] & ~keypads[lane];
+
+      // same as applying the key events one at a time, the highest newly pressed key is the last pressed
+      for (int key = 15; key >= 0; --key)
+      {
+         if (pressed & ( 1 << key ))
+         {
+            batch->pressed_key[lane] = key;
+            break;
+         }
+      }
+
+      if (released) batch->key_released[lane] = 1;
+      batch->keypad[lane] = keypads[lane];
+   }
+}
+
+// xor a sprite into the framebuffer of lane, clipped at the edges, sets VF on collision
+static void draw_sprite(Chip8Batch *batch, int lane, uint8_t x, uint8_t y, uint8_t height)
+{
+   const uint8_t *ram = batch->ram + (size_t) lane * BATCH_RAM_SIZE;
+   const uint64_t *rows = batch->framebuffers + (size_t) lane * BATCH_PIXELS_H;
+   uint16_t address = batch->I[lane];
+
+   x %= BATCH_PIXELS_W;
+   y %= BATCH_PIXELS_H;
+
+   // a height of 0 draws a 16 by 16 sprite stored as two bytes per row
+   int width = height ? 1 : 2;
+   if (height == 0) height = 16;
+
+   int visible_rows = y + height > BATCH_PIXELS_H ? BATCH_PIXELS_H - y : height;
+   uint64_t collision = 0;
+
+   for (int row = 0; row < visible_rows; ++row)
+   {
+      uint64_t sprite = (uint64_t) ram[( address + row * width ) & ( BATCH_RAM_SIZE - 1 )] << 56;
+      if (width == 2) sprite |= (uint64_t) ram[( address + row * width + 1 ) & ( BATCH_RAM_SIZE - 1 )] << 48;
+
+      // pixels shifted past the right edge are clipped
+      uint64_t bits = sprite >> x;
+      collision |= rows[y + row] & bits;
+      write_row(batch, lane, y + row, rows[y + row] ^ bits);
+   }
+
+   batch->V[0xF][lane] = collision != 0;
+}
+
+// halt the lanes of the group on an instruction the batch does not run
+static void halt_group(Chip8Batch *batch, int start, int end)
+{
+   const uint8_t *mask = batch->mask;
+
+   for (int lane = start; lane < end; ++lane)
+   {
+      batch->halted[lane] |= mask[lane];
+      batch->PC[lane] -= mask[lane] & 2;
+   }
+}
+
+// execute opcode on the lanes of batch->mask in [start, end), PC has already been advanced past it
+static void execute_group(Chip8Batch *batch, uint16_t opcode, int start, int end)
+{
+   const uint8_t *mask = batch->mask;
+   uint8_t X = ( opcode & 0x0F00 ) >> 8;
+   uint8_t Y = ( opcode & 0x00F0 ) >> 4;
+   uint8_t N = opcode & 0x000F;
+   uint8_t NN = opcode & 0x00FF;
+   uint16_t NNN = opcode & 0x0FFF;
+
+   uint8_t *VX = batch->V[X], *VY = batch->V[Y], *VF = batch->V[0xF];
+   uint16_t *PC = batch->PC, *I = batch->I;
+
+   switch (opcode >> 12)
+   {
+      case 0x0:
+      {
+         if (opcode == 0x00E0)
+         {
+            for (int lane = start; lane < end; ++lane)
+            {
+               if (!mask[lane]) continue;
+
+               for (int row = 0; row < BATCH_PIXELS_H; ++row) write_row(batch, lane, row, 0);
+            }
+         }
+         else if (opcode == 0x00EE)
+         {
+            for (int lane = start; lane < end; ++lane)
+            {
+               if (!mask[lane] || batch->sp[lane] == 0) continue;
+
+               batch->sp[lane]--;
+               PC[lane] = batch->stack[batch->sp[lane]][lane];
+            }
+         }
+         else if (( opcode & 0xFFF0 ) == 0x00C0 || ( opcode & 0xFFF0 ) == 0x00D0 || ( opcode >= 0x00FB && opcode <= 0x00FF ))
+         {
+            halt_group(batch, start, end);
+         }
+
+         // any other 0NNN machine code routine is ignored
+         break;
+      }
+      case 0x1:
+      {
+         for (int lane = start; lane < end; ++lane) PC[lane] = mask[lane] ? NNN : PC[lane];
+         break;
+      }
+      case 0x2:
+      {
+         for (int lane = start; lane < end; ++lane)
+         {
+            if (!mask[lane] || batch->sp[lane] == MAX_STACK_LEVEL) continue;
+
+            batch->stack[batch->sp[lane]][lane] = PC[lane];
+            batch->sp[lane]++;
+            PC[lane] = NNN;
+         }
+         break;
+      }
+      case 0x3:
+      {
+         for (int lane = start; lane < end; ++lane) PC[lane] += mask[lane] & ( VX[lane] == NN ? 2 : 0 );
+         break;
+      }
+      case 0x4:
+      {
+         for (int lane = start; lane < end; ++lane) PC[lane] += mask[lane] & ( VX[lane] != NN ? 2 : 0 );
+         break;
+      }
+      case 0x5:
+      {
+         if (N != 0)
+         {
+            halt_group(batch, start, end); // xo-chip register ranges
+            break;
+         }
+
+         for (int lane = start; lane < end; ++lane) PC[lane] += mask[lane] & ( VX[lane] == VY[lane] ? 2 : 0 );
+         break;
+      }
+      case 0x6:
+      {
+         for (int lane = start; lane < end; ++lane) VX[lane] = mask[lane] ? NN : VX[lane];
+         break;
+      }
+      case 0x7:
+      {
+         for (int lane = start; lane < end; ++lane) VX[lane] = mask[lane] ? VX[lane] + NN : VX[lane];
+         break;
+      }
+      case 0x8:
+      {
+         // the flag is written after the result so that it wins when X is F
+         for (int lane = start; lane < end; ++lane)
+         {
+            uint8_t x = VX[lane], y = VY[lane], result = x, flag = VF[lane];
+
+            switch (N)
+            {
+               case 0x0: result = y; break;
+               case 0x1: result = x | y; break;
+               case 0x2: result = x & y; break;
+               case 0x3: result = x ^ y; break;
+               case 0x4: result = x + y; flag = x + y > 255; break;
+               case 0x5: result = x - y; flag = x >= y; break;
+               case 0x6: result = y >> 1; flag = y & 1; break;
+               case 0x7: result = y - x; flag = y >= x; break;
+               case 0xE: result = y << 1; flag = y >> 7; break;
+               default: break;
+            }
+
+            VX[lane] = mask[lane] ? result : x;
+            VF[lane] = mask[lane] ? flag : VF[lane];
+         }
+         break;
+      }
+      case 0x9:
+      {
+         for (int lane = start; lane < end; ++lane) PC[lane] += mask[lane] & ( VX[lane] != VY[lane] ? 2 : 0 );
+         break;
+      }
+      case 0xA:
+      {
+         for (int lane = start; lane < end; ++lane) I[lane] = mask[lane] ? NNN : I[lane];
+         break;
+      }
+      case 0xB:
+      {
+         const uint8_t *V0 = batch->V[0];
+         for (int lane = start; lane < end; ++lane) PC[lane] = mask[lane] ? NNN + V0[lane] : PC[lane];
+         break;
+      }
+      case 0xC:
+      {
+         uint32_t *random_state = batch->random_state;
+
+         for (int lane = start; lane < end; ++lane)
+         {
+            uint32_t state = random_state[lane];
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+
+            random_state[lane] = mask[lane] ? state : random_state[lane];
+            VX[lane] = mask[lane] ? ( state >> 24 ) & NN : VX[lane];
+         }
+         break;
+      }
+      case 0xD:
+      {
+         for (int lane = start; lane < end; ++lane)
+         {
+            if (mask[lane]) draw_sprite(batch, lane, VX[lane], VY[lane], N);
+         }
+         break;
+      }
+      case 0xE:
+      {
+         if (NN != 0x9E && NN != 0xA1) break;
+
+         uint8_t skip_if = NN == 0x9E;
+         const uint16_t *keypad = batch->keypad;
+
+         for (int lane = start; lane < end; ++lane)
+         {
+            uint8_t pressed = ( keypad[lane] >> ( VX[lane] & 0xF ) ) & 1;
+            PC[lane] += mask[lane] & ( pressed == skip_if ? 2 : 0 );
+            batch->key_released[lane] &= ~mask[lane];
+         }
+         break;
+      }
+      case 0xF:
+      {
+         switch (NN)
+         {
+            case 0x07:
+            {
+               for (int lane = start; lane < end; ++lane) VX[lane] = mask[lane] ? batch->delay_timer[lane] : VX[lane];
+               break;
+            }
+            case 0x0A:
+            {
+               // wait for a key to be released, then store the last pressed key
+               for (int lane = start; lane < end; ++lane)
+               {
+                  if (!mask[lane]) continue;
+
+                  if (!batch->key_released[lane])
+                  {
+                     PC[lane] -= 2;
+                  }
+                  else
+                  {
+                     VX[lane] = batch->pressed_key[lane];
+                     batch->key_released[lane] = 0;
+                  }
+               }
+               break;
+            }
+            case 0x15:
+            {
+               for (int lane = start; lane < end; ++lane) batch->delay_timer[lane] = mask[lane] ? VX[lane] : batch->delay_timer[lane];
+               break;
+            }
+            case 0x18:
+            {
+               for (int lane = start; lane < end; ++lane) batch->sound_timer[lane] = mask[lane] ? VX[lane] : batch->sound_timer[lane];
+               break;
+            }
+            case 0x1E:
+            {
+               for (int lane = start; lane < end; ++lane) I[lane] = mask[lane] ? I[lane] + VX[lane] : I[lane];
+               break;
+            }
+            case 0x29:
+            {
+               for (int lane = start; lane < end; ++lane) I[lane] = mask[lane] ? FONT_START + 5 * VX[lane] : I[lane];
+               break;
+            }
+            case 0x33:
+            {
+               for (int lane = start; lane < end; ++lane)
+               {
+                  if (!mask[lane]) continue;
+
+                  write_ram(batch, lane, I[lane], VX[lane] / 100);
+                  write_ram(batch, lane, I[lane] + 1, VX[lane] / 10 % 10);
+                  write_ram(batch, lane, I[lane] + 2, VX[lane] % 10);
+               }
+               break;
+            }
+            case 0x55:
+            case 0x65:
+            {
+               bool store = NN == 0x55;
+
+               for (int lane = start; lane < end; ++lane)
+               {
+                  if (!mask[lane]) continue;
+
+                  const uint8_t *ram = batch->ram + (size_t) lane * BATCH_RAM_SIZE;
+                  for (int index = 0; index <= X; ++index)
+                  {
+                     if (store) write_ram(batch, lane, I[lane] + index, batch->V[index][lane]);
+                     else batch->V[index][lane] = ram[( I[lane] + index ) & ( BATCH_RAM_SIZE - 1 )];
+                  }
+               }
+               break;
+            }
+            default:
+            {
+               halt_group(batch, start, end); // super chip and xo-chip instructions
+               break;
+            }
+         }
+         break;
+      }
+   }
+}
+
+// lanes of a group spread over more than this many times their number run one by one instead of as a masked span
+#define GROUP_SPAN_FACTOR 4
+
+// run a group of size lanes, listed in increasing order, whose mask is set, and clear their mask again
+static void run_group(Chip8Batch *batch, uint16_t opcode, const int *lanes, int size)
+{
+   uint8_t *mask = batch->mask;
+   uint16_t *PC = batch->PC;
+   int first = lanes[0], last = lanes[size - 1];
+
+   if (last - first < GROUP_SPAN_FACTOR * size)
+   {
+      for (int lane = first; lane <= last; ++lane) PC[lane] += mask[lane] & 2;
+      execute_group(batch, opcode, first, last + 1);
+   }
+   else
+   {
+      // a masked span would mostly skip lanes of other groups, so it costs no more than separate interpreters
+      for (int i = 0; i < size; ++i)
+      {
+         PC[lanes[i]] += 2;
+         execute_group(batch, opcode, lanes[i], lanes[i] + 1);
+      }
+   }
+
+   for (int i = 0; i < size; ++i) mask[lanes[i]] = 0;
+}
+
+static int compare_keys(const void *a, const void *b)
+{
+   uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+   return ( x > y ) - ( x < y );
+}
+
+// run the size lanes sorted onto one address, reordering lanes so that each group of them is contiguous
+static void run_bucket(Chip8Batch *batch, int *lanes, int size)
+{
+   uint16_t *PC = batch->PC, *opcode = batch->opcode;
+   uint8_t *mask = batch->mask;
+   uint16_t group_pc = PC[lanes[0]], group_opcode = opcode[lanes[0]];
+   bool uniform = true;
+
+   for (int i = 0; i < size; ++i) uniform &= PC[lanes[i]] == group_pc && opcode[lanes[i]] == group_opcode;
+
+   if (uniform)
+   {
+      for (int i = 0; i < size; ++i) mask[lanes[i]] = 0xFF;
+      run_group(batch, group_opcode, lanes, size);
+      return;
+   }
+
+   // lanes that rewrote the instruction differently, or whose PC ran past the end of ram, are sorted into
+   // groups of equal PC and opcode, in increasing lane order within each group
+   uint64_t *keys = batch->group_keys;
+
+   for (int i = 0; i < size; ++i) keys[i] = (uint64_t) PC[lanes[i]] << 48 | (uint64_t) opcode[lanes[i]] << 32 | (uint32_t) lanes[i];
+   qsort(keys, size, sizeof *keys, compare_keys);
+   for (int i = 0; i < size; ++i) lanes[i] = (int) ( keys[i] & 0xFFFFFFFF );
+
+   for (int start = 0, end; start < size; start = end)
+   {
+      for (end = start; end < size && ( keys[end] >> 32 ) == ( keys[start] >> 32 ); ++end) mask[lanes[end]] = 0xFF;
+
+      run_group(batch, opcode[lanes[start]], lanes + start, end - start);
+   }
+}
+
+// run the pending lanes once they are on different instructions, counting sorted by PC into batch->order
+static void run_diverged(Chip8Batch *batch)
+{
+   int count = batch->count;
+   uint16_t *PC = batch->PC;
+   uint8_t *pending = batch->pending;
+   int *order = batch->order, *bucket_end = batch->bucket_end;
+   uint16_t *bucket_pcs = batch->bucket_pcs;
+   int used = 0;
+
+   // count the lanes on each address, remembering the addresses used so only those are visited again
+   for (int lane = 0; lane < count; ++lane)
+   {
+      if (!pending[lane]) continue;
+
+      int pc = PC[lane] & ( BATCH_RAM_SIZE - 1 );
+      if (bucket_end[pc]++ == 0) bucket_pcs[used++] = pc;
+   }
+
+   for (int bucket = 0, position = 0; bucket < used; ++bucket)
+   {
+      int size = bucket_end[bucket_pcs[bucket]];
+      bucket_end[bucket_pcs[bucket]] = position;
+      position += size;
+   }
+
+   // each bucket fills up from its start, leaving bucket_end at its end with lanes in increasing order
+   for (int lane = 0; lane < count; ++lane)
+   {
+      if (pending[lane]) order[bucket_end[PC[lane] & ( BATCH_RAM_SIZE - 1 )]++] = lane;
+   }
+
+   for (int bucket = 0, start = 0; bucket < used; ++bucket)
+   {
+      int end = bucket_end[bucket_pcs[bucket]];
+      bucket_end[bucket_pcs[bucket]] = 0;
+
+      run_bucket(batch, order + start, end - start);
+      start = end;
+   }
+}
+
+// one fetch, decode and execute cycle of every lane that has not halted, returns true if the timers ticked
+static bool run_cycle(Chip8Batch *batch)
+{
+   int count = batch->count;
+   uint16_t *PC = batch->PC, *opcode = batch->opcode;
+   uint8_t *pending = batch->pending, *mask = batch->mask;
+   int leader = count;
+
+   for (int lane = 0; lane < count; ++lane)
+   {
+      const uint8_t *ram = batch->ram + (size_t) lane * BATCH_RAM_SIZE;
+      uint16_t pc = PC[lane] & ( BATCH_RAM_SIZE - 1 );
+
+      opcode[lane] = ram[pc] << 8 | ram[( pc + 1 ) & ( BATCH_RAM_SIZE - 1 )];
+      pending[lane] = batch->halted[lane] ? 0 : 0xFF;
+      if (pending[lane] && leader == count) leader = lane;
+   }
+
+   if (leader < count)
+   {
+      // lanes of the same rom rarely diverge, so usually one group covers every lane and needs no sorting
+      uint16_t group_pc = PC[leader], group_opcode = opcode[leader];
+      uint8_t diverged = 0;
+
+      for (int lane = leader; lane < count; ++lane) diverged |= pending[lane] & ( PC[lane] != group_pc || opcode[lane] != group_opcode );
+
+      if (diverged)
+      {
+         run_diverged(batch);
+      }
+      else
+      {
+         for (int lane = leader; lane < count; ++lane)
+         {
+            mask[lane] = pending[lane];
+            PC[lane] += mask[lane] & 2;
+         }
+
+         execute_group(batch, group_opcode, leader, count);
+         memset(mask + leader, 0, count - leader);
+      }
+   }
+
+   // timers tick at 60hz of emulated time, shared by all lanes
+   if (++batch->frame_cycles >= batch->cycles_per_frame)
+   {
+      batch->frame_cycles = 0;
+
+      for (int lane = 0; lane < count; ++lane)
+      {
+         batch->delay_timer[lane] -= batch->delay_timer[lane] > 0;
+         batch->sound_timer[lane] -= batch->sound_timer[lane] > 0;
+      }
+
+      return true;
+   }
+
+   return false;
+}
+
+void batch_run(Chip8Batch *batch, int cycles)
+{
+   for (int cycle = 0; cycle < cycles; ++cycle) run_cycle(batch);
+}
+
+void batch_run_frame(Chip8Batch *batch)
+{
+   while (!run_cycle(batch));
+}
+
+const uint64_t *batch_get_framebuffers(const Chip8Batch *batch)
+{
+   return batch->framebuffers;
+}
@@ -0,0 +1,385 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "SDL.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include "../includes/capture.h"
+#include "../includes/display.h"
+
+typedef enum {
+   FORMAT_Y4M,
+   FORMAT_PNG
+} CaptureFormat;
+
+typedef struct {
+   int width, height; // resolution the frame was captured at
+   uint32_t pixels[PIXELS_W * PIXELS_H];
+} CaptureFrame;
+
+// bounded queue between the emulation and the encoder thread
+// a slot is written by the emulation while free and read by the encoder while queued, so only the counts need the lock
+static CaptureFrame queue[CAPTURE_QUEUE_SIZE];
+static int queue_head = 0, queue_count = 0;
+static bool stopping = false;
+static SDL_mutex *queue_lock = NULL;
+static SDL_cond *frame_queued = NULL, *frame_encoded = NULL;
+static SDL_Thread *encoder_thread = NULL;
+
+static bool wait_for_encoder = false;
+static uint64_t dropped_frames = 0;
+
+// output, only touched by the encoder thread while it runs
+static CaptureFormat format;
+static FILE *video_file = NULL;
+static char *png_path = NULL; // path without the .png extension
+static int out_w, out_h;
+static uint8_t *rgb = NULL;     // scaled frame, 3 bytes per pixel
+static uint8_t *encoded = NULL; // y4m planes or png file of one frame
+static uint64_t frames_encoded = 0;
+static bool write_failed = false;
+
+static uint32_t crc_table[256];
+
+static void build_crc_table()
+{
+   for (uint32_t n = 0; n < 256; ++n)
+   {
+      uint32_t c = n;
+      for (int k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320 ^ ( c >> 1 ) : c >> 1;
+      crc_table[n] = c;
+   }
+}
+
+static uint32_t crc32(const uint8_t *bytes, size_t length)
+{
+   uint32_t c = 0xFFFFFFFF;
+   for (size_t i = 0; i < length; ++i) c = crc_table[( c ^ bytes[i] ) & 0xFF] ^ ( c >> 8 );
+   return c ^ 0xFFFFFFFF;
+}
+
+static uint8_t *put_u32_be(uint8_t *bytes, uint32_t value)
+{
+   bytes[0] = value >> 24;
+   bytes[1] = value >> 16;
+   bytes[2] = value >> 8;
+   bytes[3] = value;
+   return bytes + 4;
+}
+
+// nearest neighbour scale of frame to the output size
+static void scale_frame(const CaptureFrame *frame)
+{
+   uint8_t *out = rgb;
+
+   for (int y = 0; y < out_h; ++y)
+   {
+      const uint32_t *row = frame->pixels + ( y * frame->height / out_h ) * frame->width;
+
+      for (int x = 0; x < out_w; ++x)
+      {
+         uint32_t pixel = row[x * frame->width / out_w];
+         *out++ = pixel >> 16;
+         *out++ = pixel >> 8;
+         *out++ = pixel;
+      }
+   }
+}
+
+// bt.601 limited range 4:4:4 planes
+static bool write_y4m_frame()
+{
+   int size = out_w * out_h;
+   uint8_t *y_plane = encoded, *u_plane = encoded + size, *v_plane = encoded + size * 2;
+
+   for (int i = 0; i < size; ++i)
+   {
+      int r = rgb[i * 3], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+      y_plane[i] = ( ( 66 * r + 129 * g + 25 * b + 128 ) >> 8 ) + 16;
+      u_plane[i] = ( ( -38 * r - 74 * g + 112 * b + 128 ) >> 8 ) + 128;
+      v_plane[i] = ( ( 112 * r - 94 * g - 18 * b + 128 ) >> 8 ) + 128;
+   }
+
+   return fputs("FRAME\n", video_file) >= 0 && fwrite(encoded, 1, size * 3, video_file) == (size_t) size * 3;
+}
+
+// append a png chunk of length data bytes already placed after its 8 byte header at chunk
+static uint8_t *finish_png_chunk(uint8_t *chunk, const char *type, uint32_t length)
+{
+   put_u32_be(chunk, length);
+   memcpy(chunk + 4, type, 4);
+   return put_u32_be(chunk + 8 + length, crc32(chunk + 4, length + 4));
+}
+
+// the image data is stored uncompressed in deflate blocks, which costs size but keeps encoding cheap
+static bool write_png_frame()
+{
+   static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+   uint8_t *out = encoded;
+   memcpy(out, signature, 8);
+   out += 8;
+
+   uint8_t *ihdr = out;
+   uint8_t *data = put_u32_be(put_u32_be(ihdr + 8, out_w), out_h);
+   data[0] = 8; // bits per channel
+   data[1] = 2; // rgb
+   data[2] = 0; // deflate
+   data[3] = 0; // adaptive filtering
+   data[4] = 0; // not interlaced
+   out = finish_png_chunk(ihdr, "IHDR", 13);
+
+   // zlib stream of stored blocks, every row starts with filter type 0
+   uint8_t *idat = out;
+   uint8_t *zlib = idat + 8;
+   *zlib++ = 0x78;
+   *zlib++ = 0x01;
+
+   uint32_t raw_size = out_h * ( 1 + out_w * 3 ), block_size = 0, adler_a = 1, adler_b = 0;
+   uint8_t *block = NULL;
+
+   for (uint32_t i = 0; i < raw_size; ++i)
+   {
+      if (block_size == 0)
+      {
+         block = zlib;
+         zlib += 5;
+      }
+
+      uint32_t column = i % ( 1 + out_w * 3 );
+      uint8_t byte = column == 0 ? 0 : rgb[( i / ( 1 + out_w * 3 ) ) * out_w * 3 + column - 1];
+      *zlib++ = byte;
+      adler_a = ( adler_a + byte ) % 65521;
+      adler_b = ( adler_b + adler_a ) % 65521;
+
+      if (++block_size == 65535 || i == raw_size - 1)
+      {
+         block[0] = i == raw_size - 1; // final block
+         block[1] = block_size & 0xFF;
+         block[2] = block_size >> 8;
+         block[3] = ~block_size & 0xFF;
+         block[4] = ( ~block_size >> 8 ) & 0xFF;
+         block_size = 0;
+      }
+   }
+
+   zlib = put_u32_be(zlib, adler_b << 16 | adler_a);
+   out = finish_png_chunk(idat, "IDAT", zlib - ( idat + 8 ));
+   out = finish_png_chunk(out, "IEND", 0);
+
+   char file_path[FILENAME_MAX];
+   snprintf(file_path, sizeof(file_path), "%s_%06llu.png", png_path, (unsigned long long) frames_encoded);
+
+   FILE *file = fopen(file_path, "wb");
+   if (!file) return false;
+
+   bool ok = fwrite(encoded, 1, out - encoded, file) == (size_t) ( out - encoded );
+   return fclose(file) == 0 && ok;
+}
+
+static void encode_frame(const CaptureFrame *frame)
+{
+   scale_frame(frame);
+
+   bool ok = format == FORMAT_Y4M ? write_y4m_frame() : write_png_frame();
+   frames_encoded++;
+
+   if (!ok && !write_failed)
+   {
+      write_failed = true;
+      fprintf(stderr, "Cannot write captured frame %llu, further frames may be lost\n", (unsigned long long) frames_encoded - 1);
+   }
+}
+
+static int encoder_run(void *data)
+{
+   (void) data;
+
+   while (true)
+   {
+      SDL_LockMutex(queue_lock);
+      while (queue_count == 0 && !stopping) SDL_CondWait(frame_queued, queue_lock);
+
+      if (queue_count == 0)
+      {
+         SDL_UnlockMutex(queue_lock);
+         break;
+      }
+
+      CaptureFrame *frame = &queue[queue_head];
+      SDL_UnlockMutex(queue_lock);
+
+      encode_frame(frame);
+
+      // release the slot to the emulation
+      SDL_LockMutex(queue_lock);
+      queue_head = ( queue_head + 1 ) % CAPTURE_QUEUE_SIZE;
+      queue_count--;
+      SDL_CondSignal(frame_encoded);
+      SDL_UnlockMutex(queue_lock);
+   }
+
+   return 0;
+}
+
+static bool has_suffix(const char *string, const char *suffix)
+{
+   size_t length = strlen(string), suffix_length = strlen(suffix);
+   return length >= suffix_length && strcmp(string + length - suffix_length, suffix) == 0;
+}
+
+// hand stdout to the video and send everything printed to stderr instead
+static FILE *take_stdout()
+{
+   fflush(stdout);
+
+   int video_fd = dup(fileno(stdout));
+   if (video_fd < 0 || dup2(fileno(stderr), fileno(stdout)) < 0) return NULL;
+
+   #ifdef _WIN32
+   _setmode(video_fd, _O_BINARY);
+   #endif
+
+   return fdopen(video_fd, "wb");
+}
+
+bool capture_open(const char *file_path, int scale, bool lossless)
+{
+   out_w = LORES_PIXELS_W * scale;
+   out_h = LORES_PIXELS_H * scale;
+   wait_for_encoder = lossless;
+   frames_encoded = 0;
+   dropped_frames = 0;
+   write_failed = false;
+
+   if ( has_suffix(file_path, ".png") )
+   {
+      format = FORMAT_PNG;
+
+      size_t length = strlen(file_path) - 4;
+      png_path = malloc(length + 1);
+      if (!png_path) return false;
+      memcpy(png_path, file_path, length);
+      png_path[length] = '\0';
+   }
+   else
+   {
+      format = FORMAT_Y4M;
+      video_file = strcmp(file_path, "-") == 0 ? take_stdout() : fopen(file_path, "wb");
+
+      if (!video_file)
+      {
+         printf("Cannot open capture file %s\n", file_path);
+         return false;
+      }
+
+      fprintf(video_file, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C444\n", out_w, out_h);
+   }
+
+   // a png holds the filter byte of each row, the zlib and chunk overhead and a 5 byte header per stored block
+   size_t raw_size = (size_t) out_h * ( 1 + out_w * 3 );
+   size_t encoded_size = format == FORMAT_Y4M ? (size_t) out_w * out_h * 3 : raw_size + raw_size / 65535 * 5 + 128;
+
+   rgb = malloc((size_t) out_w * out_h * 3);
+   encoded = malloc(encoded_size);
+   queue_lock = SDL_CreateMutex();
+   frame_queued = SDL_CreateCond();
+   frame_encoded = SDL_CreateCond();
+
+   if (!rgb || !encoded || !queue_lock || !frame_queued || !frame_encoded)
+   {
+      printf("Cannot allocate the frame capture buffers!\n");
+      capture_close();
+      return false;
+   }
+
+   build_crc_table();
+
+   queue_head = 0;
+   queue_count = 0;
+   stopping = false;
+   encoder_thread = SDL_CreateThread(encoder_run, "capture encoder", NULL);
+
+   if (!encoder_thread)
+   {
+      printf("Cannot start the frame capture thread: %s\n", SDL_GetError());
+      capture_close();
+      return false;
+   }
+
+   return true;
+}
+
+bool capture_is_open()
+{
+   return encoder_thread != NULL;
+}
+
+void capture_frame()
+{
+   if (!encoder_thread) return;
+
+   SDL_LockMutex(queue_lock);
+
+   if (queue_count == CAPTURE_QUEUE_SIZE && !wait_for_encoder)
+   {
+      dropped_frames++;
+      SDL_UnlockMutex(queue_lock);
+      return;
+   }
+
+   while (queue_count == CAPTURE_QUEUE_SIZE) SDL_CondWait(frame_encoded, queue_lock);
+
+   CaptureFrame *frame = &queue[( queue_head + queue_count ) % CAPTURE_QUEUE_SIZE];
+   SDL_UnlockMutex(queue_lock);
+
+   frame->width = display_get_width();
+   frame->height = display_get_height();
+   display_get_frame(frame->pixels);
+
+   SDL_LockMutex(queue_lock);
+   queue_count++;
+   SDL_CondSignal(frame_queued);
+   SDL_UnlockMutex(queue_lock);
+}
+
+void capture_close()
+{
+   if (encoder_thread)
+   {
+      SDL_LockMutex(queue_lock);
+      stopping = true;
+      SDL_CondSignal(frame_queued);
+      SDL_UnlockMutex(queue_lock);
+
+      SDL_WaitThread(encoder_thread, NULL);
+      encoder_thread = NULL;
+   }
+
+   if (video_file) fclose(video_file);
+   video_file = NULL;
+
+   if (queue_lock) SDL_DestroyMutex(queue_lock);
+   if (frame_queued) SDL_DestroyCond(frame_queued);
+   if (frame_encoded) SDL_DestroyCond(frame_encoded);
+   queue_lock = NULL;
+   frame_queued = frame_encoded = NULL;
+
+   free(png_path);
+   free(rgb);
+   free(encoded);
+   png_path = NULL;
+   rgb = encoded = NULL;
+}
+
+uint64_t capture_get_dropped_frames()
+{
+   return dropped_frames;
+}
@@ -3,71 +3,188 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <time.h>
+#include <stddef.h>
 
 #include "../includes/chip8.h"
 #include "../includes/display.h"
+#include "../includes/audio.h"
+#include "../includes/input_queue.h"
+#include "../includes/profiler.h"
+#include "../includes/romdb.h"
 
 // max length of the disassembler log buffer
 #define DSAM_LOG_SIZE 255
 
 // string containing info on what instruction is being executed in the current cycle
-static char disasembler_log[DSAM_LOG_SIZE];
+static _Thread_local char disasembler_log[DSAM_LOG_SIZE];
 
-// global chip 8 instance
-Chip8 myChip8;
+// global chip 8 instance, the one the window, debugger and audio show
+static Chip8 global_instance = { .audio_events = true };
 
-/* holds the states of the 16 keys of the keypad
-   each bit coresponds to a key that is in the pressed or released state
-   0: released
-   1: pressed
-*/
-static uint16_t keypad = 0;
+_Thread_local Chip8 *chip8_instance = &global_instance;
 
-// holds the hex value of the key that was last pressed
-static uint8_t pressed_key;
+// super chip fonts representing the numbers 0x0 - 0xF, 8 by 10 pixels
+static uint8_t big_fonts[] =
+{
+   0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+   0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+   0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+   0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+   0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+   0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+   0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+   0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+   0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+   0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+   0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+   0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+   0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+   0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+   0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+   0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
 
-// flag to check if a key was released in previous frame
-static bool is_key_released = false;
+// write a byte into ram and mark its row as changed
+static inline void ram_write(uint16_t address, uint8_t value)
+{
+   address &= RAM_SIZE - 1;
+   myChip8.ram[address] = value;
+   myChip8.ram_row_version[address / RAM_ROW_SIZE]++;
+}
 
-// fonts representing the numbers 0x0 - 0xF
-static uint8_t fonts[] = 
+// send a sound event when the sound timer starts or stops the beep
+static inline void update_sound()
 {
-   0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-   0x20, 0x60, 0x20, 0x20, 0x70, // 1
-   0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-   0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-   0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-   0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-   0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-   0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-   0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-   0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-   0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-   0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-   0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-   0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-   0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-   0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-};
+   bool sound_on = myChip8.sound_timer > 0;
+
+   if (sound_on != myChip8.sound_playing)
+   {
+      myChip8.sound_playing = sound_on;
+      if (myChip8.audio_events) audio_queue_sound_event(myChip8.cycle_count, sound_on);
+   }
+}
+
+// load the xo-chip audio pattern at address, the audio only hears of a pattern that changed
+static inline void load_audio_pattern(uint16_t address)
+{
+   bool changed = !myChip8.audio_pattern_loaded;
+
+   for (int index = 0; index < AUDIO_PATTERN_SIZE; ++index)
+   {
+      uint8_t value = myChip8.ram[(address + index) & (RAM_SIZE - 1)];
+      changed |= myChip8.audio_pattern[index] != value;
+      myChip8.audio_pattern[index] = value;
+   }
+   myChip8.audio_pattern_loaded = true;
+
+   if (changed && myChip8.audio_events) audio_queue_pattern_event(myChip8.cycle_count, myChip8.audio_pattern);
+}
+
+// set the xo-chip pitch register, sent to the audio like the pattern so it never reads the chip8 state
+static inline void set_pitch(uint8_t pitch)
+{
+   if (pitch == myChip8.pitch) return;
+
+   myChip8.pitch = pitch;
+   if (myChip8.audio_events) audio_queue_pitch_event(myChip8.cycle_count, pitch);
+}
+
+// next byte of the per instance xorshift generator
+static inline uint8_t random_byte()
+{
+   uint32_t x = myChip8.random_state;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   myChip8.random_state = x;
+   return x >> 24;
+}
+
+// skip the next instruction, which is 4 bytes long if it is the xo-chip F000 NNNN long load
+static inline void skip_instruction()
+{
+   uint16_t next_opcode = ( myChip8.ram[myChip8.PC] << 8 ) | myChip8.ram[(myChip8.PC + 1) & (RAM_SIZE - 1)];
+   myChip8.PC += ( next_opcode == 0xF000 ) ? 4 : 2;
+}
+
+// mark every row in the address range [start, end) as changed
+static void ram_mark_rows(int start, int end)
+{
+   for (int row = start / RAM_ROW_SIZE; row < ( end + RAM_ROW_SIZE - 1 ) / RAM_ROW_SIZE; ++row)
+   {
+      myChip8.ram_row_version[row]++;
+   }
+}
+
+void chip8_bind(Chip8 *instance)
+{
+   chip8_instance = instance ? instance : &global_instance;
+}
+
+// copy from into to, ram one changed row at a time and everything else but the input queue
+static void copy_state(Chip8 *to, const Chip8 *from)
+{
+   for (int row = 0; row < RAM_ROWS; ++row)
+   {
+      if (to->ram_row_version[row] != from->ram_row_version[row]) memcpy(&to->ram[row * RAM_ROW_SIZE], &from->ram[row * RAM_ROW_SIZE], RAM_ROW_SIZE);
+   }
+
+   const size_t registers_start = offsetof(Chip8, ram) + sizeof to->ram;
+   const size_t queue_end = offsetof(Chip8, input_queue) + sizeof to->input_queue;
+
+   memcpy(to, from, offsetof(Chip8, ram));
+   memcpy((uint8_t*) to + registers_start, (const uint8_t*) from + registers_start, offsetof(Chip8, input_queue) - registers_start);
+   memcpy((uint8_t*) to + queue_end, (const uint8_t*) from + queue_end, sizeof(Chip8) - queue_end);
+}
+
+void chip8_save_state(Chip8 *state)
+{
+   copy_state(state, &myChip8);
+}
+
+void chip8_restore_state(const Chip8 *state)
+{
+   copy_state(&myChip8, state);
+}
 
 void chip8_reset()
 {
    memset(myChip8.ram, 0, sizeof myChip8.ram);
    memset(myChip8.V, 0, sizeof myChip8.V);
    memset(myChip8.stack, 0, sizeof myChip8.stack);
+   memset(myChip8.rpl_flags, 0, sizeof myChip8.rpl_flags);
+   memset(myChip8.audio_pattern, 0, sizeof myChip8.audio_pattern);
+   myChip8.pitch = DEFAULT_PITCH;
+   myChip8.audio_pattern_loaded = false;
    myChip8.I = 0;
    myChip8.PC = PROGRAM_START;
    myChip8.sp = 0;
    myChip8.delay_timer = 0;
    myChip8.sound_timer = 0;
+   myChip8.cycle_count = 0;
+   myChip8.frame_count = 0;
+   myChip8.timer_cycles = 0;
+   myChip8.sound_playing = false;
+   myChip8.random_state = rand() | 1;
    
    myChip8.clock_rate = DEFAULT_CLOCK_RATE;
    myChip8.pause_flag = false;
    myChip8.cycle_step_flag = false;
 
+   myChip8.keypad = 0;
+   myChip8.is_key_released = false;
+   input_queue_init(&myChip8.input_queue);
+   myChip8.input_latency = 0;
+   myChip8.max_input_latency = 0;
+
    // load the font into address 0x050 in ram
-   memcpy(&myChip8.ram[FONT_START], fonts, sizeof fonts);
+   memcpy(&myChip8.ram[FONT_START], chip8_font, sizeof chip8_font);
+   memcpy(&myChip8.ram[BIG_FONT_START], big_fonts, sizeof big_fonts);
+   ram_mark_rows(0, RAM_SIZE);
+
+   // programs start in lores mode drawing to the first plane with a clear screen
+   display_set_planes(1);
+   display_set_hires(false);
 }
 
 int chip8_load_rom(const char* const file_path) 
@@ -101,451 +218,196 @@ int chip8_load_rom(const char* const file_path)
       return 0;
    }
 
+   ram_mark_rows(PROGRAM_START, PROGRAM_START + bytes_read);
+
 	fclose(file);
+
+   if ( romdb_is_open() ) chip8_apply_rom_config(myChip8.ram + PROGRAM_START, bytes_read);
+
    return bytes_read;
 }
 
-void chip8_run_cycle(bool log_flag)
+bool chip8_load_rom_data(const uint8_t *rom, int size)
 {
-   // fetch 16 bit opcode
-   uint16_t opcode = myChip8.ram[myChip8.PC];     // grab first 8 bits of opcode
-   opcode = opcode << 8;                          
-   opcode = opcode | myChip8.ram[myChip8.PC + 1]; // bitwise or the first 8 bits with second 8 bits to form 16 bit opcode
-
-   // first 4 bits (nibble) of a opcode
-   uint8_t first_nibble = (opcode & 0xF000) >> 12;
-   int dsam_log_offset = snprintf(disasembler_log, DSAM_LOG_SIZE, "%04x %04x ", myChip8.PC, opcode);
-   int bytes_to_write = DSAM_LOG_SIZE - dsam_log_offset;
-
-   // increment program counter to point to next intruction (next 2 bytes)
-   myChip8.PC += 2;
-   
-   switch(first_nibble)
+   if (size <= 0 || size > RAM_SIZE - PROGRAM_START) return false;
+
+   memcpy(myChip8.ram + PROGRAM_START, rom, size);
+   ram_mark_rows(PROGRAM_START, PROGRAM_START + size);
+   return true;
+}
+
+bool chip8_apply_rom_config(const uint8_t *rom, int size)
+{
+   uint8_t digest[SHA1_DIGEST_SIZE];
+   sha1(rom, size, digest);
+
+   const RomDbEntry *entry = romdb_find(digest);
+
+   if (entry == NULL)
    {
-      case 0x0: 
-      {
-         if (opcode == 0x00E0)
-         {
-            display_clear_buffer();
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "00E0 CLEAR SCREEN\n");
-         }
-         else if (opcode == 0x00EE)
-         {
-            if (myChip8.sp > 0)
-            {
-               myChip8.sp -= 1;
-               myChip8.PC = myChip8.stack[myChip8.sp]; // return from subroutine, jump to return address
-               snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "00EE RETURN: %04x from subroutine\n", myChip8.PC);
-            }
-            else
-            {
-               snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "Empty stack, cannont return!\n");
-            }
-         }
-         break;
-      } 
-      case 0x1: 
-      {
-         uint16_t NNN = opcode & 0x0FFF;
-         myChip8.PC = NNN; // jump to address NNN
-
-         snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "1NNN JUMP to NNN: %03x\n", NNN); 
-         break;
-      }
-      case 0x2: 
-      {
-         uint16_t NNN = opcode & 0x0FFF;
-
-         myChip8.stack[myChip8.sp] = myChip8.PC; // save address of next opcode onto the stack (return address)
-
-         if (myChip8.sp < MAX_STACK_LEVEL + 1)
-         {
-            myChip8.sp += 1;
-            myChip8.PC = NNN; // execute subroutine at address NNN
-         }
-         else 
-         {
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "Stack overflow occured!\n");
-         }
-
-         snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "2NNN Call Subroutine at NNN: %03x\n", NNN); 
-         break;
-      }
-      case 0x3: 
-      {
-         uint8_t X = (opcode & 0x0F00) >> 8;
-         uint8_t NN = opcode & 0x00FF;
-
-         if (myChip8.V[X] == NN)
-         {
-            myChip8.PC += 2; // skip next intruction if V[X] equals NN
-         }
-
-         snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "3XNN SKIP if VX: %d == NN %d\n", myChip8.V[X], NN); 
-         break;
-      }
-      case 0x4: 
-      {
-         uint8_t X = (opcode & 0x0F00) >> 8;
-         uint8_t NN = opcode & 0x00FF;
-
-         if (myChip8.V[X] != NN)
-         {
-            myChip8.PC += 2; // skip next instruction if V[X] not equals NN
-         }
-
-         snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "4XNN SKIP if VX: %d != NN: %d\n", myChip8.V[X], NN); 
-         break;
-      }
-      case 0x5: 
-      {
-         uint8_t X = (opcode & 0x0F00) >> 8;
-         uint8_t Y = (opcode & 0x00F0) >> 4;
-
-         if (myChip8.V[X] == myChip8.V[Y])
-         {
-            myChip8.PC += 2; // skip next instruction if V[X] equals V[Y]
-         }
-
-         snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "5XY0 SKIP if VX: %d == VY: %d\n", myChip8.V[X], myChip8.V[Y]);
-         break;
-      }
-      case 0x6: 
-      {
-         uint8_t X = (opcode & 0x0F00) >> 8;
-         uint8_t NN = opcode & 0x00FF;
-
-         snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "6XNN LOAD VX: %d with NN: %d\n", myChip8.V[X], NN); 
-         myChip8.V[X] = NN; // load register V[X] with 8 bit immediate NN
-
-         break;
-      }
-      case 0x7: 
-      {
-         uint8_t X = (opcode & 0x0F00) >> 8;
-         uint16_t NN = opcode & 0x00FF;
-
-         snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "7XNN ADD NN: %d into VX: %d\n", NN, myChip8.V[X]); 
-         myChip8.V[X] += NN; // add 8 bit immediate to register V[X]
- 
-         break;
-      }
-      case 0x8: 
-      {
-         uint8_t last_nibble = opcode & 0x000F;
-         uint8_t X = (opcode & 0x0F00) >> 8;
-         uint8_t Y = (opcode & 0x00F0) >> 4;
-
-         if (last_nibble == 0x0)
-         {
-            myChip8.V[X] = myChip8.V[Y]; // store V[Y] into V[X]
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "8XY0 MOV VY: %d into VX\n", myChip8.V[Y]);
-         }
-         else if (last_nibble == 0x1)
-         {
-            myChip8.V[X] = myChip8.V[X] | myChip8.V[Y]; // set V[X] to biwize or of V[X] and V[Y]
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "8XY1 OR VX VY\n");
-         }
-         else if (last_nibble == 0x2)
-         {
-            myChip8.V[X] = myChip8.V[X] & myChip8.V[Y]; // set V[X] to biwize and of V[X] and V[Y]
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "8XY2 AND VX VY\n");
-         }
-         else if (last_nibble == 0x3)
-         {
-            // to XOR two bit patterns get results of bitwise AND and bitwise NOR
-            // then NOR these two results together to get the XOR output
-
-            uint8_t AND = myChip8.V[X] & myChip8.V[Y];
-            uint8_t NOR = ~ ( myChip8.V[X] | myChip8.V[Y] ); // a bitwise NOR is the negated output of a bitwise OR
-
-            // bitwise NOR the previous AND and NOR outputs
-            uint8_t XOR_output = ~ ( AND | NOR );
-
-            myChip8.V[X] = XOR_output; // store VX XOR VY into VX
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "8XY3 XOR VX VY\n");
-         }
-         else if (last_nibble == 0x4)
-         {
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "8XY4 ADD VX: %d VY: %d\n", myChip8.V[X],  myChip8.V[Y]); 
-
-            uint8_t  first_operand = myChip8.V[X]; // save value of VX for overflow check later
-
-            // add VY to VX, will wrap on overflow because registers are unsigned
-            myChip8.V[X] += myChip8.V[Y]; 
-            
-            // set register VF to 1 on overflow, otherwise set to 0
-            myChip8.V[0xF] = ( first_operand + myChip8.V[Y]) > 255; 
-         }
-         else if (last_nibble == 0x5)
-         {
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "8XY5 SUB VX: %d VY: %d\n", myChip8.V[X], myChip8.V[Y]);
-
-            uint8_t minuend = myChip8.V[X];
-            uint8_t subtrahend = myChip8.V[Y];
-
-            // V[X] = V[X] - V[Y]
-            myChip8.V[X] = minuend - subtrahend;
-            // set register V[F] to 1 if V[X] >= V[Y]
-            myChip8.V[0xF] = ( minuend >= subtrahend );
-         }
-         else if (last_nibble == 0x6)
-         {
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "8XY6 RIGHT SHIFT 1 bit VY INTO VX\n");
-
-            uint8_t VY_temp = myChip8.V[Y];
-
-            // right shift V[Y] by 1 bit and store result into V[X]
-            myChip8.V[X] = myChip8.V[Y] >> 1;
-
-            // store least significant bit of V[Y] into V[F]
-            myChip8.V[0xF] = VY_temp & 1 ;
-         }
-         else if (last_nibble == 0x7)
-         { 
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "8XY7 SUB VY: %d VX: %d\n", myChip8.V[Y], myChip8.V[X]);
-
-            uint8_t minuend = myChip8.V[Y];
-            uint8_t subtrahend = myChip8.V[X];
-
-            // V[X] = V[Y] - V[X]
-            myChip8.V[X] = minuend - subtrahend;
-
-            // set register V[F] to 1 if V[Y] >= V[X]
-            myChip8.V[0xF] = minuend >= subtrahend;
-         }
-         else if (last_nibble == 0xE)
-         {
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "8XYE RIGHT SHIFT 1 bit VY INTO VX\n");
-
-            uint8_t VY_temp = myChip8.V[Y];
-
-            // left shift V[Y] by 1 bit and store result into V[X]
-            myChip8.V[X] = myChip8.V[Y] << 1;
-
-            // store most significant bit of V[Y] into V[F]
-            myChip8.V[0xF] = ( VY_temp & (1 << 7) ) >> 7;
-         }
-
-         break;
-      }
-      case 0x9: 
-      {
-         uint8_t X = (opcode & 0x0F00) >> 8;
-         uint8_t Y = (opcode & 0x00F0) >> 4;
-
-         if (myChip8.V[X] != myChip8.V[Y])
-         {
-            myChip8.PC += 2; // skip next instruction if V[X] not equals V[Y]
-         }
-
-         snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "9XY0 SKIP IF VX: %d != VY: %d\n", myChip8.V[X], myChip8.V[Y]); 
-         break;
-      }
-      case 0xA: 
-      {
-         uint16_t NNN = opcode & 0x0FFF;
-
-         myChip8.I = NNN; // load address register with address NNN
-         
-         snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "ANNN LOAD I REG with NNN: %03x\n", NNN);
-         break;
-      }
-      case 0xB: 
-      {
-         uint16_t NNN = opcode & 0x0FFF;
-
-         myChip8.PC = NNN + myChip8.V[0];
-
-         snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "BNNN JUMP TO NNN: %03x + V0: %d\n", NNN, myChip8.V[0]); 
-         break;
-      }
-      case 0xC: 
-      {
-         uint8_t X = ( opcode & 0x0F00 ) >> 8;
-         uint8_t NN = ( opcode & 0x00FF );
-
-         int random_number = rand();
-         myChip8.V[X] = random_number & NN;        
-
-         snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "CXNN RAND NUM: %d\n", myChip8.V[X]); 
-         break;
-      }
-      case 0xD: 
-      {
-         uint8_t X = (opcode & 0x0F00) >> 8;
-         uint8_t Y = (opcode & 0x00F0) >> 4;
-         uint8_t N = (opcode & 0x000F);
-
-         display_draw(myChip8.V[X] % PIXELS_W, myChip8.V[Y] % PIXELS_H, N);
-         snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "DXYN DRAW SPRITE AT VX: %d, VY: %d, N: %d pixels high\n", myChip8.V[X] % PIXELS_W, myChip8.V[Y] % PIXELS_H, N); 
-
-         break;
-      }
-      case 0xE: 
-      {
-         uint8_t last_two_nibble = opcode & 0x00FF;
-         uint8_t X = ( opcode & 0x0F00 ) >> 8;
-
-         uint16_t mask = 1 << ( myChip8.V[X] );
-         uint8_t key = ( keypad & mask ) >> ( myChip8.V[X] );
-
-         if (last_two_nibble == 0x9E)
-         {
-            // skip next instruction if key with the hex value in V[X] is pressed
-            if (key == 1) myChip8.PC += 2;
-            is_key_released = false;
-            
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "EX9E SKIP IF key %1x is pressed\n", myChip8.V[X]);
-         }
-         else if (last_two_nibble == 0xA1)
-         {
-            // skip next instruction if key with the hex value in V[X] is not pressed
-            if (key == 0) myChip8.PC += 2;
-            is_key_released = false;
-
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "EXA1 SKIP IF key %1x not pressed\n", myChip8.V[X]);
-         }
-
-         break;
-      }
-      case 0xF: 
-      {
-         uint8_t X = (opcode & 0x0F00) >> 8;
-         uint8_t last_two_nibble = opcode & 0x00FF;
-
-         if (last_two_nibble == 0x07)
-         {
-            myChip8.V[X] = myChip8.delay_timer;
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "FX07 LOAD delay_timer: %d into VX\n", myChip8.delay_timer);
-         }
-         else if (last_two_nibble == 0x0A)
-         {
-            // wait for key release and store released key in VX
-            // when keypad is zero it means no keys are being pressed
-            // so we decrement program counter to wait for a key press again
-            if ( !is_key_released ) myChip8.PC -= 2;
-            else 
-            {
-               myChip8.V[X] = pressed_key; // else we set V[X] to the key that last was pressed
-               is_key_released = false;    // reset flag back to false
-            }
-
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "FX0A WAIT for keypress and store in VX\n");
-         }
-         else if (last_two_nibble == 0x15)
-         {
-            // set delay timer to value of register V[X]
-            myChip8.delay_timer = myChip8.V[X];
-
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "FX15 SET delay timer to value in VX: %d\n", myChip8.V[X]);
-         }
-         else if (last_two_nibble == 0x18)
-         {
-            // set sound timer to value of register V[X]
-            myChip8.sound_timer = myChip8.V[X];
-
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "FX18 SET sound timer to value in VX: %d\n", myChip8.V[X]);
-         }
-         else if (last_two_nibble == 0x1E)
-         {
-            // add value in register V[X] to register I
-            myChip8.I += myChip8.V[X];
-
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "FX1E ADD VX: %d to register I\n", myChip8.V[X]);
-         }
-         else if (last_two_nibble == 0x29)
-         {
-            // set I to point to the font sprite corresponding to the hex value in V[X]
-            // multiply by 5 because fonts are 5 pixels high
-            myChip8.I = FONT_START + ( 5 * myChip8.V[X] );
-
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "FX29 SET register I to point to font with hex value in VX: %d\n", myChip8.V[X]);
-         }
-         else if (last_two_nibble == 0x33)
-         {
-            // store the binary coded decimal of value in V[X] at: I, I + 1, I + 2
-            uint8_t decimal = myChip8.V[X];
-
-            uint8_t ones = decimal % 10;
-            uint8_t tens = ( ( decimal - ones ) % 100 ) / 10;
-            uint8_t hundreds =  ( ( decimal - ones ) - ( ( decimal - ones ) % 100 ) ) / 100;
-
-            myChip8.ram[myChip8.I] = hundreds;
-            myChip8.ram[myChip8.I + 1] = tens;
-            myChip8.ram[myChip8.I + 2] = ones;
-
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "FX33 STORE BCD %d %d %d of VX: %d into address starting add reg I\n", hundreds, tens, hundreds, myChip8.V[X]);
-         }
-         else if (last_two_nibble == 0x55)
-         {
-            // load registers V[0] - V[X] into memory starting at address I
-            for (int index = 0; index <= X; ++index)
-            {
-               myChip8.ram[myChip8.I + index] = myChip8.V[index];
-            }
-
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "FX55 LOAD V0 to VX into memory starting at address I\n");
-         }
-         else if (last_two_nibble == 0x65)
-         {
-            // load values from memory starting at address I into registers V[0] - V[X]
-            for (int index = 0; index <= X; ++index)
-            {
-               myChip8.V[index] = myChip8.ram[myChip8.I + index];
-            }
-
-            snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "FX65 LOAD values starting from address I into registers V0 to VX\n");
-         }
-   
-         break;
-      };
-      default: snprintf(disasembler_log + dsam_log_offset, bytes_to_write, "Invalid opcode encountered!\n");
+      printf("rom not found in the rom database\n");
+      return false;
    }
 
-   // decrement timers every cycle
-   chip8_update_timers();
+   chip8_set_quirk_profile(entry->quirk_profile);
+   if (entry->cycles_per_frame)
+   {
+      uint32_t clock_rate = entry->cycles_per_frame * 60;
+      myChip8.clock_rate = clock_rate < MAX_CLOCK_RATE ? clock_rate : MAX_CLOCK_RATE;
+   }
+
+   for (int color = 0; color < ROMDB_COLORS; ++color)
+   {
+      uint32_t argb = entry->colors[color];
+      if ( ( argb >> 24 ) == 0 ) continue;
 
-   if (log_flag) printf("%s", disasembler_log);
+      display_set_plane_color(color, ( ( argb >> 16 ) & 0xFF ) / 255.0f, ( ( argb >> 8 ) & 0xFF ) / 255.0f, ( argb & 0xFF ) / 255.0f);
+   }
+
+   printf("rom database: %s rom, %s quirks, %u hz\n", romdb_platform_name(entry->platform), chip8_quirk_profile_name(entry->quirk_profile), myChip8.clock_rate);
+   return true;
+}
+
+// specialised cores, one per quirk profile
+
+#define CORE_FUNCTION run_cycle_default
+#define QUIRK_VF_RESET false
+#define QUIRK_MEMORY_INCREMENT false
+#define QUIRK_SHIFT_VX false
+#define QUIRK_JUMP_VX false
+#define QUIRK_WRAP false
+#include "chip8_core.inc"
+
+#define CORE_FUNCTION run_cycle_vip
+#define QUIRK_VF_RESET true
+#define QUIRK_MEMORY_INCREMENT true
+#define QUIRK_SHIFT_VX false
+#define QUIRK_JUMP_VX false
+#define QUIRK_WRAP false
+#include "chip8_core.inc"
+
+#define CORE_FUNCTION run_cycle_schip
+#define QUIRK_VF_RESET false
+#define QUIRK_MEMORY_INCREMENT false
+#define QUIRK_SHIFT_VX true
+#define QUIRK_JUMP_VX true
+#define QUIRK_WRAP false
+#include "chip8_core.inc"
+
+#define CORE_FUNCTION run_cycle_xochip
+#define QUIRK_VF_RESET false
+#define QUIRK_MEMORY_INCREMENT true
+#define QUIRK_SHIFT_VX false
+#define QUIRK_JUMP_VX false
+#define QUIRK_WRAP true
+#include "chip8_core.inc"
+
+static const chip8_cycle_function quirk_profile_cores[QUIRK_PROFILES] =
+{
+   [QUIRKS_DEFAULT] = run_cycle_default,
+   [QUIRKS_VIP] = run_cycle_vip,
+   [QUIRKS_SCHIP] = run_cycle_schip,
+   [QUIRKS_XOCHIP] = run_cycle_xochip
+};
+
+void chip8_set_quirk_profile(QuirkProfile profile)
+{
+   if (profile >= QUIRK_PROFILES) profile = QUIRKS_DEFAULT;
+
+   myChip8.quirk_profile = profile;
+}
+
+QuirkProfile chip8_get_quirk_profile()
+{
+   return myChip8.quirk_profile;
+}
+
+chip8_cycle_function chip8_get_cycle_function()
+{
+   return quirk_profile_cores[myChip8.quirk_profile];
+}
+
+void chip8_run_cycle(bool log_flag)
+{
+   quirk_profile_cores[myChip8.quirk_profile](log_flag);
+}
+
+void chip8_run_cycle_profiled(bool log_flag)
+{
+   uint16_t opcode = ( myChip8.ram[myChip8.PC] << 8 ) | myChip8.ram[(myChip8.PC + 1) & (RAM_SIZE - 1)];
+   profiler_record(myChip8.PC, opcode);
+
+   quirk_profile_cores[myChip8.quirk_profile](log_flag);
 }
 
 void chip8_set_key_down(uint8_t key)
 {
-   keypad = keypad | ( 1 << key );
-   pressed_key = key;
+   myChip8.keypad = myChip8.keypad | ( 1 << key );
+   myChip8.pressed_key = key;
 }
 
 void chip8_set_key_up(uint8_t key)
 {
-   keypad = keypad & ~( 1 << key );
-   is_key_released = true;
+   myChip8.keypad = myChip8.keypad & ~( 1 << key );
+   myChip8.is_key_released = true;
+}
+
+bool chip8_queue_key_event(uint8_t key, bool down, uint64_t timestamp)
+{
+   InputEvent event = { .timestamp = timestamp, .key = key & 0xF, .down = down };
+   return input_queue_push(&myChip8.input_queue, event);
+}
+
+void chip8_process_key_events(uint64_t now)
+{
+   InputEvent event;
+
+   while ( input_queue_pop(&myChip8.input_queue, &event) )
+   {
+      if (event.down) 
+         chip8_set_key_down(event.key);
+      else 
+         chip8_set_key_up(event.key);
+
+      myChip8.input_latency = now - event.timestamp;
+      if (myChip8.input_latency > myChip8.max_input_latency) myChip8.max_input_latency = myChip8.input_latency;
+   }
+}
+
+uint64_t chip8_get_input_latency()
+{
+   return myChip8.input_latency;
+}
+
+uint64_t chip8_get_max_input_latency()
+{
+   return myChip8.max_input_latency;
 }
 
 void chip8_update_timers()
 {
-   static float dt = 0;
-   static clock_t current_time, previous_time = 0;
+   myChip8.cycle_count++;
 
-   current_time = clock();
-   dt += (float) ( current_time - previous_time ) / CLOCKS_PER_SEC;
-   previous_time = current_time;
+   // timers count down at 60hz of emulated time so that they keep pace with the program at any clock rate
+   // below 60hz an instruction spans more than one tick, each of them is run
+   myChip8.timer_cycles += 60;
 
-   while (dt >= (float) 1 / 60)
+   while (myChip8.timer_cycles >= myChip8.clock_rate)
    {
+      myChip8.timer_cycles -= myChip8.clock_rate;
+      myChip8.frame_count++;
+
       if (myChip8.delay_timer > 0) myChip8.delay_timer -= 1;
       if (myChip8.sound_timer > 0) myChip8.sound_timer -= 1;
 
       // play beep audio when sound timer is not zero
-      if (myChip8.sound_timer > 0) 
-         display_pause_audio_device(0);
-      else 
-         display_pause_audio_device(1);
+      update_sound();
 
-      dt -= (float) 1 / 60;
+      if (myChip8.audio_events) audio_sync(myChip8.cycle_count, myChip8.clock_rate);
    }
 }
 
 uint16_t chip8_get_keypad()
 {
-   return keypad;
+   return myChip8.keypad;
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "../includes/debugger.h"
+#include "../includes/chip8.h"
+#include "../includes/audio.h"
+
+/*
+	seqlock guarding the published snapshot
+	odd: the emulator is in the middle of writing the snapshot
+	even: the snapshot is consistent
+*/
+static atomic_uint sequence = 0;
+
+static Chip8Snapshot published;
+
+/*
+	single producer single consumer ring buffer of control changes
+	the gui thread is the only producer and the emulation thread the only consumer
+*/
+static Command commands[COMMAND_QUEUE_SIZE];
+static atomic_uint command_head = 0; // next command to pop, only written by the consumer
+static atomic_uint command_tail = 0; // next free slot, only written by the producer
+
+void debugger_publish_snapshot()
+{
+   unsigned int seq = atomic_load_explicit(&sequence, memory_order_relaxed);
+
+   // mark snapshot as being written before any of the data is touched
+   atomic_store_explicit(&sequence, seq + 1, memory_order_relaxed);
+   atomic_thread_fence(memory_order_release);
+
+   memcpy(&published.chip8, &myChip8, sizeof published.chip8);
+   published.keypad = chip8_get_keypad();
+   published.sequence = seq + 2;
+
+   atomic_store_explicit(&sequence, seq + 2, memory_order_release);
+}
+
+bool debugger_read_snapshot(Chip8Snapshot *snapshot)
+{
+   unsigned int seq_begin, seq_end;
+
+   do
+   {
+      seq_begin = atomic_load_explicit(&sequence, memory_order_acquire);
+
+      // snapshot already holds this publish, skip the copy
+      if (seq_begin == snapshot->sequence) return false;
+
+      // writer is in the middle of a publish, try again
+      if (seq_begin & 1) continue;
+
+      memcpy(snapshot, &published, sizeof *snapshot);
+
+      atomic_thread_fence(memory_order_acquire);
+      seq_end = atomic_load_explicit(&sequence, memory_order_relaxed);
+   } while ( (seq_begin & 1) || seq_begin != seq_end ); // retry if a publish happened while copying
+
+   return true;
+}
+
+bool debugger_push_command(CommandType type, uint32_t value)
+{
+   unsigned int tail = atomic_load_explicit(&command_tail, memory_order_relaxed);
+   unsigned int head = atomic_load_explicit(&command_head, memory_order_acquire);
+
+   if (tail - head == COMMAND_QUEUE_SIZE) return false; // queue is full
+
+   commands[tail & (COMMAND_QUEUE_SIZE - 1)] = (Command) { .type = type, .value = value };
+
+   atomic_store_explicit(&command_tail, tail + 1, memory_order_release);
+   return true;
+}
+
+void debugger_process_commands()
+{
+   unsigned int head = atomic_load_explicit(&command_head, memory_order_relaxed);
+   unsigned int tail = atomic_load_explicit(&command_tail, memory_order_acquire);
+
+   for (; head != tail; ++head)
+   {
+      Command command = commands[head & (COMMAND_QUEUE_SIZE - 1)];
+
+      switch (command.type)
+      {
+         case COMMAND_TOGGLE_PAUSE:
+         {
+            myChip8.pause_flag = !myChip8.pause_flag;
+            if (myChip8.pause_flag)
+            {
+               printf("Paused, press space to step through a single instruction or press f5 again to resume.\n");
+               audio_mute_volume(true); // mute audio when paused
+            }
+            else
+            {
+               audio_mute_volume(false); // unmute audio when unpaused
+            }
+            break;
+         }
+         case COMMAND_CYCLE_STEP:
+         {
+            if (myChip8.pause_flag) myChip8.cycle_step_flag = true;
+            break;
+         }
+         case COMMAND_SET_CLOCK_RATE:
+         {
+            if (command.value >= MIN_CLOCK_RATE && command.value <= MAX_CLOCK_RATE) myChip8.clock_rate = command.value;
+            break;
+         }
+      }
+   }
+
+   atomic_store_explicit(&command_head, head, memory_order_release);
+}
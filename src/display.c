@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include <stdbool.h>
 #include "SDL.h"
 
@@ -9,45 +10,34 @@
 static SDL_Window *gWindow = NULL;
 static SDL_Renderer *gRenderer = NULL;
 
-static SDL_AudioSpec want, have;
-static SDL_AudioDeviceID device_id;
+// texture the display buffer is unpacked into every frame, scaled up to the chip8 viewport when copied
+static SDL_Texture *gTexture = NULL;
 
-// array of rectangles representing a pixel for the display
-static SDL_Rect Display [PIXELS_W * PIXELS_H];
+// area of the window the chip8 display is drawn to
+static SDL_Rect viewport_rect;
 
-// keeps track of the on or off state of a rectangle (pixel)
-// 0: off, pixel is black
-// 1: on, pixel is white
-static uint8_t Display_buffer [PIXELS_W * PIXELS_H];
+// display state of the global chip8 instance, the one shown in the window
+static DisplayState global_state = { .plane_mask = 1, .hires = false, .width = LORES_PIXELS_W, .height = LORES_PIXELS_H };
 
-static int VIEWPORT_W = 0, VIEWPORT_H = 0;
-
-static Colorf fg_color = { .r = 1, .g = 1, .b = 1 };
-static Colorf bg_color = { .r = 0, .g = 0, .b = 0 };
+// state the drawing functions of the calling thread act on
+static _Thread_local DisplayState *state = &global_state;
 
-static int volume = DEFAULT_VOLUME;
+static int VIEWPORT_W = 0, VIEWPORT_H = 0;
 
-// callback for sdl to use for generating sound
-static void audio_callback(void* userdata, uint8_t* stream, int streamSize)
+// color of a pixel indexed by the planes it is lit in
+static Colorf plane_colors[DISPLAY_COLORS] =
 {
-   Sint16 *audioBuffer = (Sint16*) stream;
-   int audioBufferLength = streamSize / 2; // streamSize in bytes divide by 2 for length of 16 bit int array
-   size_t *runningSampleIndex = (size_t*) userdata; // track the current sample across writes to the buffer
-   int sampleValue;
-
-   for (int sampleIndex = 0; sampleIndex < audioBufferLength; ++sampleIndex)
-   {
-      sampleValue = ( ( *runningSampleIndex / HALF_PERIOD ) % 2 ) ? volume : -volume;
-      audioBuffer[sampleIndex] = sampleValue;
-      (*runningSampleIndex)++;
-   }
-}
+   { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 0.4f, 0.0f }, { 0.4f, 0.13f, 0.0f },
+   { 0.8f, 0.2f, 0.2f }, { 0.2f, 0.8f, 0.2f }, { 0.2f, 0.4f, 0.9f }, { 0.9f, 0.9f, 0.2f },
+   { 0.5f, 0.5f, 0.5f }, { 0.6f, 0.2f, 0.6f }, { 0.2f, 0.7f, 0.7f }, { 0.9f, 0.6f, 0.7f },
+   { 0.3f, 0.3f, 0.3f }, { 0.7f, 0.7f, 0.7f }, { 0.5f, 0.3f, 0.1f }, { 0.1f, 0.3f, 0.2f }
+};
 
 bool display_init(int display_scale_factor, bool gui_flag)
 {
-   // scale up resolution based on scale factor
-   VIEWPORT_W = PIXELS_W * display_scale_factor;
-   VIEWPORT_H = PIXELS_H * display_scale_factor;
+   // scale up lores resolution based on scale factor, hires pixels are drawn at half the size
+   VIEWPORT_W = LORES_PIXELS_W * display_scale_factor;
+   VIEWPORT_H = LORES_PIXELS_H * display_scale_factor;
 
    // initialize SDL
    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
@@ -73,89 +63,105 @@ bool display_init(int display_scale_factor, bool gui_flag)
       return false;
    }
 
-   // initialze display with 64 * 32 rectangles (pixels)
-   // rectangles here represent a single pixel
-   int number_of_rects = PIXELS_W * PIXELS_H;
-   int rect_w = VIEWPORT_W / PIXELS_W;
-   int rect_h = VIEWPORT_H / PIXELS_H;
-   int rect_pos_x = 0;
-   int rect_pos_y = 0;
-   int row_count = 0; // row position of a rect
-   for (int rect_number = 0; rect_number < number_of_rects; ++rect_number)
-   {
-      rect_pos_x = ( rect_w * (rect_number % PIXELS_W) ) + LEFT_OFFSET; 
-      if (rect_number % PIXELS_W == 0)
-      {
-         rect_pos_y = ( rect_h * (row_count++) ) + TOP_OFFSET; // post decrement make sure to use initial row_count value of 0 on first pass
-      }
-
-      Display[rect_number] = (SDL_Rect)
-      { 
-         .x = rect_pos_x,
-         .y = rect_pos_y, 
-         .w = rect_w, 
-         .h = rect_h 
-      };
-   }
-
-   // initialize sdl audio
-
-   static size_t runningSampleIndex = 0; // track the current sample across writes to the buffer
-
-   SDL_memset( &want, 0, sizeof( want ) );
-   want.freq = SAMPLES_PER_SEC;
-   want.format = AUDIO_S16SYS;
-   want.channels = 1;
-   want.samples = 2048;
-   want.callback = audio_callback;
-   want.userdata = &runningSampleIndex;
-   
-   // attempt to open audio device, error if it returns 0
-   if ( ( device_id = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0) ) == 0 )
-   {
-      printf("SDL could not get an audio device! SDL Error: %s\n", SDL_GetError());
-      return false;
-   }
-   
-   if (have.format != AUDIO_S16SYS)
+   gTexture = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, PIXELS_W, PIXELS_H);
+   if (gTexture == NULL)
    {
-      printf("SDL could not get desired audio format! SDL Error: %s\n", SDL_GetError());
+      printf("Display texture could not be created! SDL Error: %s\n", SDL_GetError());
       return false;
    }
 
+   viewport_rect = (SDL_Rect) 
+   { 
+      .x = LEFT_OFFSET, 
+      .y = TOP_OFFSET, 
+      .w = VIEWPORT_W, 
+      .h = VIEWPORT_H 
+   };
+
    return true;
 }
 
 void display_close()
 {
+   SDL_DestroyTexture(gTexture);
+   gTexture = NULL;
+
    SDL_DestroyRenderer(gRenderer);
    SDL_DestroyWindow(gWindow);
    gRenderer = NULL;
    gWindow = NULL;
 
-   SDL_CloseAudioDevice(device_id);
-
    SDL_Quit();
    printf("closing sdl!\n");
 }
 
-void display_update()
+// argb colors of the planes
+static void build_palette(Uint32 palette[DISPLAY_COLORS])
 {
-   for (int pixel = 0; pixel < PIXELS_H * PIXELS_W; ++pixel)
+   for (int color = 0; color < DISPLAY_COLORS; ++color)
    {
-      // if pixel on set color to white
-      if (Display_buffer[pixel])
+      palette[color] = 0xFF000000 | (Uint32) ( plane_colors[color].r * 0xFF ) << 16 | (Uint32) ( plane_colors[color].g * 0xFF ) << 8 | (Uint32) ( plane_colors[color].b * 0xFF );
+   }
+}
+
+// unpack row y of the current resolution into argb pixels
+static void unpack_row(int y, Uint32 *pixels, const Uint32 palette[DISPLAY_COLORS])
+{
+   for (int word = 0; word < state->width / 64; ++word)
+   {
+      uint64_t plane_words[DISPLAY_PLANES];
+      for (int plane = 0; plane < DISPLAY_PLANES; ++plane) plane_words[plane] = state->buffer[plane][y][word];
+
+      for (int bit = 63; bit >= 0; --bit)
       {
-         SDL_SetRenderDrawColor(gRenderer, fg_color.r * 0xFF, fg_color.g * 0xFF, fg_color.b * 0xFF, SDL_ALPHA_OPAQUE);
-         SDL_RenderFillRect(gRenderer, &Display[pixel]);
+         int color = 0;
+         for (int plane = 0; plane < DISPLAY_PLANES; ++plane) color |= ( ( plane_words[plane] >> bit ) & 1 ) << plane;
+
+         *pixels++ = palette[color];
       }
-      // else pixel is off so we set color to black
-      else
+   }
+}
+
+void display_update()
+{
+   Uint32 palette[DISPLAY_COLORS];
+   build_palette(palette);
+
+   void *pixels;
+   int pitch;
+
+   if (SDL_LockTexture(gTexture, NULL, &pixels, &pitch) < 0) return;
+
+   // unpack the rows of the current resolution, the rest of the texture is never shown
+   for (int y = 0; y < state->height; ++y) unpack_row(y, (Uint32*) ( (uint8_t*) pixels + y * pitch ), palette);
+
+   SDL_UnlockTexture(gTexture);
+
+   SDL_Rect source = { .x = 0, .y = 0, .w = state->width, .h = state->height };
+   SDL_RenderCopy(gRenderer, gTexture, &source, &viewport_rect);
+}
+
+void display_get_frame(uint32_t *pixels)
+{
+   Uint32 palette[DISPLAY_COLORS];
+   build_palette(palette);
+
+   for (int y = 0; y < state->height; ++y) unpack_row(y, pixels + y * state->width, palette);
+}
+
+int display_get_packed(uint8_t *bytes)
+{
+   uint8_t *out = bytes;
+
+   for (int plane = 0; plane < DISPLAY_PLANES; ++plane)
+   {
+      for (int y = 0; y < state->height; ++y)
       {
-         SDL_SetRenderDrawColor(gRenderer, bg_color.r * 0xFF, bg_color.g *0xFF, bg_color.b *0xFF, SDL_ALPHA_OPAQUE);
-         SDL_RenderFillRect(gRenderer, &Display[pixel]);
+         for (int x = 0; x < state->width; x += 8) *out++ = state->buffer[plane][y][x / 64] >> ( 56 - x % 64 );
       }
    }
+
+   return out - bytes;
 }
 
 void display_present()
@@ -163,54 +169,181 @@ void display_present()
    SDL_RenderPresent(gRenderer);
 }
 
-void display_draw(uint8_t x_pos, uint8_t y_pos, uint8_t sprite_height)
+// xor one sprite row into a display row starting at pixel x, pixels past the right edge are wrapped or clipped
+// sprite is left aligned, its first pixel in the most significant bit
+// returns true if any pixel was turned off
+static bool display_xor_row(uint64_t *row, uint64_t sprite, int x, bool wrap)
+{
+   int words = state->width / 64;
+   int word = x / 64;
+   int shift = x % 64;
+
+   uint64_t left = sprite >> shift;
+   uint64_t right = shift ? sprite << ( 64 - shift ) : 0; // part of the sprite that spills into the next word
+
+   bool collision = row[word] & left;
+   row[word] ^= left;
+
+   // rows are a whole number of words so wrapping only means spilling into the first word of the row
+   int next = word + 1;
+   if (next == words)
+   {
+      if (!wrap) return collision;
+      next = 0;
+   }
+
+   collision |= ( row[next] & right ) != 0;
+   row[next] ^= right;
+
+   return collision;
+}
+
+void display_draw(uint8_t x_pos, uint8_t y_pos, uint8_t sprite_height, bool wrap)
 {
    // first clear the VF flag incase it was previously set to 1
    myChip8.V[0xF] = 0;
 
-   const int sprite_width = 8; // sprites are always 8 bits (pixels) wide
+   // the starting position always wraps around the screen
+   x_pos %= state->width;
+   y_pos %= state->height;
 
-   uint8_t *sprite = &myChip8.ram[myChip8.I]; // sprite data at starting address I in ram
+   // a height of 0 draws a 16 by 16 sprite stored as two bytes per row
+   int sprite_width = sprite_height ? 1 : 2;
+   if (sprite_height == 0) sprite_height = 16;
 
-   uint16_t display_sprite_origin = ( y_pos * PIXELS_W  ) + x_pos; // position in display buffer to draw sprite to
+   // clipped rows are never read or written
+   int visible_rows = sprite_height;
+   if (!wrap && y_pos + visible_rows > state->height) visible_rows = state->height - y_pos;
 
-   // iterate through entire sprite byte by byte
-   for(int sprite_byte = 0; sprite_byte < sprite_height; ++sprite_byte)
+   uint16_t sprite_address = myChip8.I; // sprite data at starting address I in ram
+   bool collision = false;
+
+   for (int plane = 0; plane < DISPLAY_PLANES; ++plane)
    {
-      // stop drawing if we go over the max pixel height
-      if (y_pos + sprite_byte >= PIXELS_H)
+      if ( !( state->plane_mask & ( 1 << plane ) ) ) continue;
+
+      for (int sprite_row = 0; sprite_row < visible_rows; ++sprite_row)
       {
-         break;
+         uint64_t sprite = 0;
+         for (int byte = 0; byte < sprite_width; ++byte)
+         {
+            sprite |= (uint64_t) myChip8.ram[( sprite_address + sprite_row * sprite_width + byte ) & (RAM_SIZE - 1)] << ( 56 - 8 * byte );
+         }
+
+         collision |= display_xor_row(state->buffer[plane][( y_pos + sprite_row ) % state->height], sprite, x_pos, wrap);
       }
 
-      // iterate through sprit_byte bit by bit
-      for (int sprite_bit = 0; sprite_bit < sprite_width; ++sprite_bit)
+      // the next selected plane is drawn with the sprite that follows
+      sprite_address += sprite_height * sprite_width;
+   }
+
+   // set VF flag if any pixel was switched off
+   if (collision) myChip8.V[0xF] = 1;
+}
+
+void display_scroll_down(uint8_t rows)
+{
+   if (rows > state->height) rows = state->height;
+
+   for (int plane = 0; plane < DISPLAY_PLANES; ++plane)
+   {
+      if ( !( state->plane_mask & ( 1 << plane ) ) ) continue;
+
+      // rows are contiguous so the whole plane moves with one copy
+      memmove(state->buffer[plane][rows], state->buffer[plane][0], ( state->height - rows ) * sizeof state->buffer[plane][0]);
+      memset(state->buffer[plane][0], 0, rows * sizeof state->buffer[plane][0]);
+   }
+}
+
+void display_scroll_up(uint8_t rows)
+{
+   if (rows > state->height) rows = state->height;
+
+   for (int plane = 0; plane < DISPLAY_PLANES; ++plane)
+   {
+      if ( !( state->plane_mask & ( 1 << plane ) ) ) continue;
+
+      memmove(state->buffer[plane][0], state->buffer[plane][rows], ( state->height - rows ) * sizeof state->buffer[plane][0]);
+      memset(state->buffer[plane][state->height - rows], 0, rows * sizeof state->buffer[plane][0]);
+   }
+}
+
+void display_scroll_left()
+{
+   int words = state->width / 64;
+
+   for (int plane = 0; plane < DISPLAY_PLANES; ++plane)
+   {
+      if ( !( state->plane_mask & ( 1 << plane ) ) ) continue;
+
+      for (int y = 0; y < state->height; ++y)
       {
-         // stop drawing if we go over the max pixel width
-         if (x_pos + sprite_bit >= PIXELS_W)
+         uint64_t *row = state->buffer[plane][y];
+
+         for (int word = 0; word < words; ++word)
          {
-            break;
+            uint64_t carry = word + 1 < words ? row[word + 1] >> 60 : 0;
+            row[word] = ( row[word] << 4 ) | carry;
          }
+      }
+   }
+}
 
-         // state of the display pixel that we wish to XOR with
-         uint8_t display_pixel_state = Display_buffer[display_sprite_origin + (sprite_byte * PIXELS_W) + sprite_bit];
-         
-         // state of sprite pixel that we wish to XOR with
-         uint8_t sprite_pixel_state = sprite[sprite_byte] & ( 1 << ( 7 - sprite_bit ) ); // extract the specific bit with a bitmask
-         sprite_pixel_state = sprite_pixel_state >> ( 7 - sprite_bit );
-   
-         // set VF flag if both states are on (equals 1)
-         if (display_pixel_state == 1 && sprite_pixel_state == 1)
+void display_scroll_right()
+{
+   int words = state->width / 64;
+
+   for (int plane = 0; plane < DISPLAY_PLANES; ++plane)
+   {
+      if ( !( state->plane_mask & ( 1 << plane ) ) ) continue;
+
+      for (int y = 0; y < state->height; ++y)
+      {
+         uint64_t *row = state->buffer[plane][y];
+
+         for (int word = words - 1; word >= 0; --word)
          {
-            myChip8.V[0xF] = 1;
+            uint64_t carry = word > 0 ? row[word - 1] << 60 : 0;
+            row[word] = ( row[word] >> 4 ) | carry;
          }
-
-         // xor display buffer pixel state with sprite pixel state
-         Display_buffer[display_sprite_origin + (sprite_byte * PIXELS_W) + sprite_bit] = display_pixel_state ^ sprite_pixel_state;
       }
    }
 }
 
+void display_set_hires(bool hires_flag)
+{
+   state->hires = hires_flag;
+   state->width = state->hires ? PIXELS_W : LORES_PIXELS_W;
+   state->height = state->hires ? PIXELS_H : LORES_PIXELS_H;
+
+   memset(state->buffer, 0, sizeof state->buffer);
+}
+
+void display_set_planes(uint8_t mask)
+{
+   state->plane_mask = mask & ( DISPLAY_COLORS - 1 );
+}
+
+uint8_t display_get_planes()
+{
+   return state->plane_mask;
+}
+
+bool display_is_hires()
+{
+   return state->hires;
+}
+
+int display_get_width()
+{
+   return state->width;
+}
+
+int display_get_height()
+{
+   return state->height;
+}
+
 void display_clear()
 {
    SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0x00, 0xFF);
@@ -219,13 +352,21 @@ void display_clear()
 
 void display_clear_buffer()
 {
-   // set all display pixels to off state
-   memset(Display_buffer, 0, PIXELS_H * PIXELS_W);
+   // set all display pixels of the selected planes to off state
+   for (int plane = 0; plane < DISPLAY_PLANES; ++plane)
+   {
+      if (state->plane_mask & ( 1 << plane )) memset(state->buffer[plane], 0, sizeof state->buffer[plane]);
+   }
+}
+
+void display_bind(DisplayState *display_state)
+{
+   state = display_state ? display_state : &global_state;
 }
 
-void display_pause_audio_device(int pause_on)
+DisplayState *display_get_state()
 {
-   SDL_PauseAudioDevice(device_id, pause_on);
+   return state;
 }
 
 SDL_Window *display_get_window()
@@ -249,38 +390,19 @@ void display_get_viewport_size(int *width, int *height)
 
 void display_set_bg_color(float r, float g, float b)
 {
-   bg_color.r = r;
-   bg_color.g = g;
-   bg_color.b = b;
+   display_set_plane_color(0, r, g, b);
 }
 
 void display_set_fg_color(float r, float g, float b)
 {
-   fg_color.r = r;
-   fg_color.g = g;
-   fg_color.b = b;
-}
-
-void display_set_volume(int vol)
-{
-   if ( vol >= 0 )
-   {
-      volume = vol;  
-   } 
+   display_set_plane_color(1, r, g, b);
 }
 
-void display_mute_volume(bool mute_flag)
+void display_set_plane_color(int index, float r, float g, float b)
 {
-   // save value of volume before muting
-   static int volume_before_mute = DEFAULT_VOLUME;
+   if (index < 0 || index >= DISPLAY_COLORS) return;
 
-   if (mute_flag)
-   {
-      volume_before_mute = volume;
-      volume = 0;
-   }
-   else
-   {
-      volume = volume_before_mute;
-   }
-}
\ No newline at end of file
+   plane_colors[index].r = r;
+   plane_colors[index].g = g;
+   plane_colors[index].b = b;
+}
@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../includes/env.h"
+
+static uint16_t read_reward_value(const Chip8Env *env, int lane, const EnvReward *source)
+{
+   const uint8_t *ram = env->batch->ram + (size_t) lane * BATCH_RAM_SIZE;
+   uint16_t value = ram[source->address & ( BATCH_RAM_SIZE - 1 )];
+
+   if (source->size == 2) value = value << 8 | ram[( source->address + 1 ) & ( BATCH_RAM_SIZE - 1 )];
+
+   return value;
+}
+
+// take the current values as the base the next step is rewarded against
+static void latch_reward_values(Chip8Env *env, int lane)
+{
+   uint16_t *values = env->reward_values + (size_t) lane * ENV_MAX_REWARDS;
+
+   for (int index = 0; index < env->reward_count; ++index) values[index] = read_reward_value(env, lane, &env->reward_sources[index]);
+
+   env->rewards[lane] = 0.0f;
+}
+
+Chip8Env *env_create(const uint8_t *rom, int rom_size, int lanes, uint32_t seed)
+{
+   Chip8Env *env = calloc(1, sizeof *env);
+   if (!env) return NULL;
+
+   env->batch = batch_create(lanes, rom, rom_size, seed);
+   env->reward_values = calloc(lanes, ENV_MAX_REWARDS * sizeof(uint16_t));
+   env->rewards = calloc(lanes, sizeof(float));
+
+   if (!env->batch || !env->reward_values || !env->rewards)
+   {
+      env_destroy(env);
+      return NULL;
+   }
+
+   return env;
+}
+
+void env_destroy(Chip8Env *env)
+{
+   if (!env) return;
+
+   batch_destroy(env->batch);
+   free(env->reward_values);
+   free(env->rewards);
+   free(env);
+}
+
+const uint64_t *env_reset(Chip8Env *env, uint32_t seed)
+{
+   env->batch->frame_cycles = 0;
+
+   for (int lane = 0; lane < env->batch->count; ++lane) env_reset_lane(env, lane, seed);
+
+   return batch_get_framebuffers(env->batch);
+}
+
+void env_reset_lane(Chip8Env *env, int lane, uint32_t seed)
+{
+   batch_reset_lane(env->batch, lane, seed);
+   latch_reward_values(env, lane);
+}
+
+bool env_add_reward(Chip8Env *env, uint16_t address, uint8_t size, float weight)
+{
+   if (env->reward_count == ENV_MAX_REWARDS || size < 1 || size > 2) return false;
+
+   env->reward_sources[env->reward_count++] = (EnvReward) { .address = address, .size = size, .weight = weight };
+
+   for (int lane = 0; lane < env->batch->count; ++lane) latch_reward_values(env, lane);
+
+   return true;
+}
+
+const uint64_t *env_step(Chip8Env *env, const uint16_t *action_masks, int frames)
+{
+   batch_set_keypads(env->batch, action_masks);
+
+   for (int frame = 0; frame < frames; ++frame) batch_run_frame(env->batch);
+
+   for (int lane = 0; lane < env->batch->count; ++lane)
+   {
+      uint16_t *values = env->reward_values + (size_t) lane * ENV_MAX_REWARDS;
+      float reward = 0.0f;
+
+      for (int index = 0; index < env->reward_count; ++index)
+      {
+         uint16_t value = read_reward_value(env, lane, &env->reward_sources[index]);
+         reward += env->reward_sources[index].weight * ( (int) value - (int) values[index] );
+         values[index] = value;
+      }
+
+      env->rewards[lane] = reward;
+   }
+
+   return batch_get_framebuffers(env->batch);
+}
+
+const float *env_get_rewards(const Chip8Env *env)
+{
+   return env->rewards;
+}
+
+const uint8_t *env_get_halted(const Chip8Env *env)
+{
+   return env->batch->halted;
+}
+
+int env_get_lane_count(const Chip8Env *env)
+{
+   return env->batch->count;
+}
+
+void env_clone_state(const Chip8Env *env, int lane, BatchLaneState *state)
+{
+   batch_save_lane(env->batch, lane, state);
+}
+
+void env_restore_state(Chip8Env *env, int lane, const BatchLaneState *state)
+{
+   batch_load_lane(env->batch, lane, state);
+
+   // the reward values at the end of a step are the ones in ram, so they need no saving
+   latch_reward_values(env, lane);
+}
@@ -1,5 +1,8 @@
 #include "stdio.h"
 #include "stdint.h"
+#include "stdlib.h"
+#include "string.h"
+#include "math.h"
 
 #define NK_INCLUDE_FIXED_TYPES
 #define NK_INCLUDE_STANDARD_IO
@@ -16,6 +19,10 @@
 #include "../includes/gui.h"
 #include "../includes/display.h"
 #include "../includes/chip8.h"
+#include "../includes/debugger.h"
+#include "../includes/profiler.h"
+#include "../includes/perf.h"
+#include "../includes/audio.h"
 
 static struct nk_context *ctx = NULL;
 
@@ -33,6 +40,43 @@ static struct nk_colorf fg_color = { 1, 1, 1, 1 };
 
 static int viewport_width;
 
+// gui refresh pacing, all times are in performance counter ticks
+
+static uint64_t refresh_interval = 0;  // ticks between gui rebuilds at the configured refresh rate
+static uint64_t frame_budget = 0;      // ticks a rebuild may take before rebuilds are spaced further apart
+static uint64_t next_refresh_time = 0; // rebuild is due once the performance counter reaches this
+
+// true once the widgets were built from the input gathered since the last nk_input_begin
+static bool input_consumed = true;
+
+// copy of the chip8 state read once per frame, widgets never touch myChip8 directly
+static Chip8Snapshot snapshot;
+
+// memory viewer caches
+
+// number of gui frames a written byte stays highlighted in the memory viewer
+#define MEMORY_HIGHLIGHT_FRAMES 30
+
+// two character hex strings for every byte value
+static char hex_table[256][3];
+
+// four character hex strings of the starting address of every row in ram
+static char address_labels[RAM_ROWS][5];
+
+// last seen version and contents of every ram row, used to find which bytes changed
+static uint32_t row_version[RAM_ROWS];
+static uint8_t row_bytes[RAM_SIZE];
+
+// gui frame that each byte of ram was last seen changing on
+static uint32_t byte_written_frame[RAM_SIZE];
+
+// number of frames the gui has built, used to time out write highlighting
+static uint32_t gui_frame = MEMORY_HIGHLIGHT_FRAMES;
+
+static void memory_viewer_init(void);
+static void memory_viewer_sync(int first_row, int end_row);
+static struct nk_color memory_heat_color(int address);
+
 // gui widgets
 
 static void widget_stack(float x_pos, float y_pos, float width, float height);
@@ -40,6 +84,7 @@ static void widget_memory(float x_pos, float y_pos, float width, float height);
 static void widget_cpu_state(float x_pos, float y_pos, float width, float height);
 static void widget_keypad(float x_pos, float y_pos, float width, float height);
 static void widget_debug(float x_pos, float y_pos, float width, float height);
+static void widget_perf(float x_pos, float y_pos, float width, float height);
 static void widget_general(float x_pos, float y_pos, float width, float height);
 
 void gui_close()
@@ -58,6 +103,9 @@ void gui_init()
 
    ctx = nk_sdl_init( window, renderer );
 
+   gui_set_refresh_rate(GUI_DEFAULT_REFRESH_RATE);
+   gui_set_frame_budget(GUI_DEFAULT_FRAME_BUDGET);
+
    // load fonts
    struct nk_font_atlas *atlas;
    struct nk_font_config config = nk_font_config(0);
@@ -72,11 +120,18 @@ void gui_init()
    // create nk colors
    RED = nk_rgb(247, 47, 47);
    CYAN = nk_rgb(44, 191, 191);
+
+   memory_viewer_init();
 }
 
 void gui_input_begin()
 {
+   // keep accumulating input across display frames until the widgets are rebuilt
+   // so clicks and scrolls between two gui refreshes are not lost
+   if (!input_consumed) return;
+
    nk_input_begin(ctx);
+   input_consumed = false;
 }
 
 void gui_input_end()
@@ -89,8 +144,29 @@ void gui_handle_event(SDL_Event *event)
    nk_sdl_handle_event(event);
 }
 
+void gui_set_refresh_rate(int refresh_rate)
+{
+   if (refresh_rate < 1) refresh_rate = 1;
+   refresh_interval = SDL_GetPerformanceFrequency() / refresh_rate;
+}
+
+void gui_set_frame_budget(float budget_ms)
+{
+   if (budget_ms <= 0) budget_ms = GUI_DEFAULT_FRAME_BUDGET;
+   frame_budget = SDL_GetPerformanceFrequency() * budget_ms / 1000;
+}
+
+bool gui_refresh_due()
+{
+   return SDL_GetPerformanceCounter() >= next_refresh_time;
+}
+
 void gui_create_widgets()
 {
+   uint64_t build_start = SDL_GetPerformanceCounter();
+
+   debugger_read_snapshot(&snapshot);
+
    widget_stack( 0, 0, GUI_STACK_WIDGET_W, (float) window_height );
    widget_memory( GUI_STACK_WIDGET_W, 0, GUI_MEMORY_WIDGET_W, (float) window_height );
 
@@ -100,16 +176,83 @@ void gui_create_widgets()
    widget_cpu_state( GUI_STACK_WIDGET_W + GUI_MEMORY_WIDGET_W, 0, GUI_CPU_STATE_WIDGET_W, WIDGET_CPU_STATE_HEIGHT );
    widget_keypad( GUI_STACK_WIDGET_W + GUI_MEMORY_WIDGET_W, WIDGET_CPU_STATE_HEIGHT, GUI_KEYPAD_W, WIDGET_KEYPAD_HEIGHT );
 
-   const float WIDGET_DEBUG_WIDTH = viewport_width * 0.3;
-   const float WIDGET_GENERAL_WIDTH = viewport_width * 0.7;
+   const float WIDGET_DEBUG_WIDTH = viewport_width * 0.2;
+   const float WIDGET_PERF_WIDTH = viewport_width * 0.35;
+   const float WIDGET_GENERAL_WIDTH = viewport_width * 0.45;
 
    widget_debug( GUI_STACK_WIDGET_W + GUI_MEMORY_WIDGET_W + GUI_CPU_STATE_WIDGET_W, 0, WIDGET_DEBUG_WIDTH, GUI_DEBUG_H );
-   widget_general( GUI_STACK_WIDGET_W + GUI_MEMORY_WIDGET_W + GUI_CPU_STATE_WIDGET_W + WIDGET_DEBUG_WIDTH, 0, WIDGET_GENERAL_WIDTH, GUI_GENERAL_H );
+   widget_perf( GUI_STACK_WIDGET_W + GUI_MEMORY_WIDGET_W + GUI_CPU_STATE_WIDGET_W + WIDGET_DEBUG_WIDTH, 0, WIDGET_PERF_WIDTH, GUI_PERF_H );
+   widget_general( GUI_STACK_WIDGET_W + GUI_MEMORY_WIDGET_W + GUI_CPU_STATE_WIDGET_W + WIDGET_DEBUG_WIDTH + WIDGET_PERF_WIDTH, 0, WIDGET_GENERAL_WIDTH, GUI_GENERAL_H );
+
+   nk_sdl_convert(NK_ANTI_ALIASING_ON);
+   input_consumed = true;
+
+   // schedule the next rebuild, when this one went over budget space rebuilds out
+   // proportionally so the average time spent on the gui stays within budget
+   uint64_t build_end = SDL_GetPerformanceCounter();
+   uint64_t build_time = build_end - build_start;
+   uint64_t interval = refresh_interval;
+
+   if (build_time > frame_budget) interval = refresh_interval * build_time / frame_budget;
+
+   next_refresh_time = build_start + interval;
+   if (next_refresh_time < build_end) next_refresh_time = build_end;
 }
 
 void gui_draw()
 {
-   nk_sdl_render(NK_ANTI_ALIASING_ON);
+   nk_sdl_draw();
+}
+
+static void memory_viewer_init()
+{
+   static const char digits[] = "0123456789ABCDEF";
+
+   for (int value = 0; value < 256; ++value)
+   {
+      hex_table[value][0] = digits[value >> 4];
+      hex_table[value][1] = digits[value & 0xF];
+      hex_table[value][2] = '\0';
+   }
+
+   for (int row = 0; row < RAM_ROWS; ++row)
+   {
+      snprintf(address_labels[row], sizeof address_labels[row], "%04X", row * RAM_ROW_SIZE);
+   }
+
+   // start out in sync with the current ram so the initial contents are not highlighted as writes
+   memcpy(row_bytes, myChip8.ram, sizeof row_bytes);
+   memcpy(row_version, myChip8.ram_row_version, sizeof row_version);
+}
+
+// compare row versions of the latest snapshot with the cached ones for the rows from first_row up to end_row,
+// the rows on screen, and record which bytes changed. rows that just scrolled into view are brought up to date
+// without highlighting, their writes happened while they were not shown
+static void memory_viewer_sync(int first_row, int end_row)
+{
+   static int visible_first_row = 0;
+   static int visible_end_row = 0;
+
+   for (int row = first_row; row < end_row; ++row)
+   {
+      if (row_version[row] == snapshot.chip8.ram_row_version[row]) continue;
+
+      row_version[row] = snapshot.chip8.ram_row_version[row];
+
+      bool was_visible = row >= visible_first_row && row < visible_end_row;
+
+      for (int address = row * RAM_ROW_SIZE; address < ( row + 1 ) * RAM_ROW_SIZE; ++address)
+      {
+         if (row_bytes[address] != snapshot.chip8.ram[address])
+         {
+            row_bytes[address] = snapshot.chip8.ram[address];
+            if (was_visible) byte_written_frame[address] = gui_frame;
+         }
+      }
+   }
+
+   visible_first_row = first_row;
+   visible_end_row = end_row;
 }
 
 static void widget_stack(float x_pos, float y_pos, float width, float height)
@@ -124,13 +267,13 @@ static void widget_stack(float x_pos, float y_pos, float width, float height)
    {
       for (int stack_level = 0; stack_level < MAX_STACK_LEVEL; ++stack_level)
       {
-         snprintf(stack_value_buffer, STACK_VALUE_LABEL_SIZE, "%04X", myChip8.stack[stack_level]);
+         snprintf(stack_value_buffer, STACK_VALUE_LABEL_SIZE, "%04X", snapshot.chip8.stack[stack_level]);
          snprintf(stack_level_buffer, STACK_COUNT_LABEL_SIZE, "%d", stack_level);
 
          nk_layout_row_begin(ctx, NK_DYNAMIC, 15, 2);
 
          nk_layout_row_push(ctx, 0.4);
-         nk_label_colored(ctx, stack_level_buffer, NK_TEXT_CENTERED, myChip8.sp == stack_level ? CYAN : RED );
+         nk_label_colored(ctx, stack_level_buffer, NK_TEXT_CENTERED, snapshot.chip8.sp == stack_level ? CYAN : RED );
 
          nk_layout_row_push(ctx, 0.6);
          nk_label(ctx, stack_value_buffer, NK_TEXT_LEFT);
@@ -147,17 +290,21 @@ static void widget_stack(float x_pos, float y_pos, float width, float height)
 
 static void widget_memory(float x_pos, float y_pos, float width, float height)
 {
-   #define MEMORY_ADDRESS_LABEL_SIZE 5
-   #define MEMORY_VALUE_LABEL_SIZE 3
-   #define NUM_OF_COLS 9
-   
-   static char memory_address_buffer[MEMORY_ADDRESS_LABEL_SIZE];
-   static char memory_value_buffer[MEMORY_VALUE_LABEL_SIZE];
+   #define NUM_OF_COLS ( RAM_ROW_SIZE + 1 )
+   #define JUMP_ADDRESS_BUFFER_SIZE 5 // four hex digits and the terminator
 
    static int64_t y_scroll = 0;
    static bool end_reached = false;
 
    static float widths[NUM_OF_COLS] = { 45, 15, 15, 15, 15, 15, 15, 15, 15 }; // widths for each of the 9 columns in a row
+   static float jump_widths[4] = { 35, 50, 40, 50 };
+
+   static char jump_address_buffer[JUMP_ADDRESS_BUFFER_SIZE];
+   static int jump_address_length = 0;
+   static int jump_address = -1; // address last jumped to, its row label is highlighted
+   static nk_bool show_heatmap = nk_true;
+
+   gui_frame++;
 
    if ( nk_begin( ctx, "Memory", nk_rect(x_pos, y_pos, width, height), NK_WINDOW_BORDER|NK_WINDOW_TITLE|NK_WINDOW_NO_SCROLLBAR ) )
    {
@@ -189,37 +336,93 @@ static void widget_memory(float x_pos, float y_pos, float width, float height)
          }
       }
 
-      nk_layout_row(ctx, NK_STATIC, 15, 9, widths);
+      int num_of_rows = ( nk_window_get_height(ctx) / 20 ) - 1; // one row is taken up by the jump to address field
 
-      int num_of_rows = ( nk_window_get_height(ctx) / 20 );
-      
-      int address = y_scroll * 8;
-      int address_row = address + (num_of_rows * 8);
-      for (address; address < address_row; address += 8)
+      // jump to address row, with a heatmap toggle when the profiler is running
+      nk_layout_row(ctx, NK_STATIC, 20, profiler_enabled() ? 4 : 3, jump_widths);
+      nk_label_colored(ctx, "Goto", NK_TEXT_LEFT, RED);
+      nk_flags edit_state = nk_edit_string(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER, jump_address_buffer, &jump_address_length, JUMP_ADDRESS_BUFFER_SIZE - 1, nk_filter_hex);
+      if ( nk_button_label(ctx, "Jump") || ( edit_state & NK_EDIT_COMMITED ) )
+      {
+         jump_address_buffer[jump_address_length] = '\0';
+         jump_address = (int) strtol(jump_address_buffer, NULL, 16) & ( RAM_SIZE - 1 );
+
+         // scroll so that the row holding the address is at the top, without scrolling past the end of ram
+         y_scroll = jump_address / RAM_ROW_SIZE;
+         if (y_scroll > RAM_ROWS - num_of_rows) y_scroll = RAM_ROWS - num_of_rows;
+         if (y_scroll < 0) y_scroll = 0;
+         end_reached = false;
+      }
+
+      if ( profiler_enabled() ) nk_checkbox_label(ctx, "Heat", &show_heatmap);
+
+      bool heatmap = profiler_enabled() && show_heatmap;
+
+      int end_row = y_scroll + num_of_rows < RAM_ROWS ? y_scroll + num_of_rows : RAM_ROWS;
+      memory_viewer_sync(y_scroll, end_row);
+
+      nk_layout_row(ctx, NK_STATIC, 15, NUM_OF_COLS, widths);
+
+      // only rows that are visible are laid out, text comes from precomputed tables so no formatting is done per frame
+      for (int64_t row = y_scroll; row < y_scroll + num_of_rows; ++row)
       {
-         if (address == RAM_SIZE)
+         if (row == RAM_ROWS)
          {  
             end_reached = true;
             break;
          }
 
-         snprintf(memory_address_buffer, MEMORY_ADDRESS_LABEL_SIZE, "%04X", address);
+         bool jumped_row = jump_address >= 0 && row == jump_address / RAM_ROW_SIZE;
+         nk_label_colored(ctx, address_labels[row], NK_TEXT_CENTERED, jumped_row ? CYAN : RED);
 
-         nk_label_colored(ctx, memory_address_buffer, NK_TEXT_CENTERED, RED);
-
-         for (int byte = 0; byte < 8; ++byte)
+         for (int byte = 0; byte < RAM_ROW_SIZE; ++byte)
          {
-            snprintf(memory_value_buffer, MEMORY_VALUE_LABEL_SIZE, "%02X", myChip8.ram[address + byte]);
-            nk_label(ctx, memory_value_buffer, NK_TEXT_CENTERED);
+            int address = row * RAM_ROW_SIZE + byte;
+            uint8_t value = snapshot.chip8.ram[address];
+
+            // highlight bytes that were written recently
+            if ( gui_frame - byte_written_frame[address] < MEMORY_HIGHLIGHT_FRAMES )
+               nk_label_colored(ctx, hex_table[value], NK_TEXT_CENTERED, CYAN);
+            else if (heatmap)
+               nk_label_colored(ctx, hex_table[value], NK_TEXT_CENTERED, memory_heat_color(address));
+            else
+               nk_label(ctx, hex_table[value], NK_TEXT_CENTERED);
          }
       }
    }
+   else
+   {
+      memory_viewer_sync(0, 0); // no rows on screen while the window is collapsed
+   }
 
    nk_end(ctx);
 
-   #undef MEMORY_ADDRESS_LABEL_SIZE
-   #undef MEMORY_VALUE_LABEL_SIZE
    #undef NUM_OF_COLS
+   #undef JUMP_ADDRESS_BUFFER_SIZE
+}
+
+// text color of a byte in the heatmap, fades from the normal text color to red the more often
+// the instruction covering the byte was executed, on a log scale relative to the hottest address
+static struct nk_color memory_heat_color(int address)
+{
+   static const struct nk_color HOT = { 255, 96, 0, 255 };
+
+   struct nk_color cold = ctx->style.text.color;
+   uint64_t max_count = profiler_get_max_pc_count();
+
+   // an instruction covers two bytes, starting either at this address or at the one before it
+   uint64_t count = profiler_get_pc_count(address);
+   if (address > 0 && profiler_get_pc_count(address - 1) > count) count = profiler_get_pc_count(address - 1);
+
+   if (count == 0 || max_count == 0) return cold;
+
+   float heat = logf(1.0f + count) / logf(1.0f + max_count);
+
+   return nk_rgb( 
+      cold.r + ( HOT.r - cold.r ) * heat, 
+      cold.g + ( HOT.g - cold.g ) * heat, 
+      cold.b + ( HOT.b - cold.b ) * heat 
+   );
 }
 
 static void widget_cpu_state(float x_pos, float y_pos, float width, float height)
@@ -237,17 +440,17 @@ static void widget_cpu_state(float x_pos, float y_pos, float width, float height
       nk_layout_row(ctx, NK_STATIC, 15, 2, widths);
 
       // program counter row
-      snprintf(register_value_buffer, REGISTER_VALUE_BUFFER_SIZE, "%04X", myChip8.PC);
+      snprintf(register_value_buffer, REGISTER_VALUE_BUFFER_SIZE, "%04X", snapshot.chip8.PC);
       nk_label_colored(ctx, "PC:", NK_TEXT_RIGHT, RED);
       nk_label(ctx, register_value_buffer, NK_TEXT_RIGHT);
 
       // address register I row
-      snprintf(register_value_buffer, REGISTER_VALUE_BUFFER_SIZE, "%04X", myChip8.I);
+      snprintf(register_value_buffer, REGISTER_VALUE_BUFFER_SIZE, "%04X", snapshot.chip8.I);
       nk_label_colored(ctx, "I:", NK_TEXT_RIGHT, RED);
       nk_label(ctx, register_value_buffer, NK_TEXT_RIGHT);
 
       // stack pointer register row
-      snprintf(register_value_buffer, REGISTER_VALUE_BUFFER_SIZE, "%02X", myChip8.sp);
+      snprintf(register_value_buffer, REGISTER_VALUE_BUFFER_SIZE, "%02X", snapshot.chip8.sp);
       nk_label_colored(ctx, "SP:", NK_TEXT_RIGHT, RED);
       nk_label(ctx, register_value_buffer, NK_TEXT_RIGHT);
 
@@ -265,7 +468,7 @@ static void widget_cpu_state(float x_pos, float y_pos, float width, float height
       for (int i = 0; i < V_REGISTERS; ++i)
       {
          snprintf(v_register_label, V_REGISTER_LABEL_BUFFER_SIZE, "V%01X:", i);
-         snprintf(register_value_buffer, REGISTER_VALUE_BUFFER_SIZE, "%02X", myChip8.V[i]);
+         snprintf(register_value_buffer, REGISTER_VALUE_BUFFER_SIZE, "%02X", snapshot.chip8.V[i]);
 
          nk_label_colored(ctx, v_register_label, NK_TEXT_RIGHT, RED);
          nk_label(ctx, register_value_buffer, NK_TEXT_CENTERED);
@@ -276,11 +479,11 @@ static void widget_cpu_state(float x_pos, float y_pos, float width, float height
       // timers
       nk_layout_row(ctx, NK_STATIC, 15, 2, widths);
 
-      snprintf(register_value_buffer, REGISTER_VALUE_BUFFER_SIZE, "%02X", myChip8.delay_timer);
+      snprintf(register_value_buffer, REGISTER_VALUE_BUFFER_SIZE, "%02X", snapshot.chip8.delay_timer);
       nk_label_colored(ctx, "DT:", NK_TEXT_RIGHT, RED);
       nk_label(ctx, register_value_buffer, NK_TEXT_RIGHT);
 
-      snprintf(register_value_buffer, REGISTER_VALUE_BUFFER_SIZE, "%02X", myChip8.sound_timer);
+      snprintf(register_value_buffer, REGISTER_VALUE_BUFFER_SIZE, "%02X", snapshot.chip8.sound_timer);
       nk_label_colored(ctx, "ST:", NK_TEXT_RIGHT, RED);
       nk_label(ctx, register_value_buffer, NK_TEXT_RIGHT);
    }
@@ -312,7 +515,7 @@ static void widget_keypad(float x_pos, float y_pos, float width, float height)
       button_style.hover.data.color = RED;
 
       // 16 bit keypad state retrieved from cpu
-      uint16_t keypad_states = chip8_get_keypad();
+      uint16_t keypad_states = snapshot.keypad;
 
        // 16 bit int where each bit represents on or off state of the gui keypad button
       static uint16_t gui_button_states = 0;
@@ -331,7 +534,7 @@ static void widget_keypad(float x_pos, float y_pos, float width, float height)
          if ( nk_button_text_styled(ctx, &button_style, &keypad_labels[i], 1) )
          {
             gui_button_states = gui_button_states | ( 1 << keypad_values[i] );
-            chip8_set_key_down(keypad_values[i]);
+            chip8_queue_key_event(keypad_values[i], true, SDL_GetPerformanceCounter());
          }  
          else
          {
@@ -340,7 +543,7 @@ static void widget_keypad(float x_pos, float y_pos, float width, float height)
             // only register a key up event if the button was previously in the on state
             if (button == 1)
             {
-               chip8_set_key_up(keypad_values[i]);
+               chip8_queue_key_event(keypad_values[i], false, SDL_GetPerformanceCounter());
             }
 
             gui_button_states = gui_button_states & ~( 1 << keypad_values[i] );
@@ -360,7 +563,7 @@ static void widget_debug(float x_pos, float y_pos, float width, float height)
       struct nk_style_button button_style = ctx->style.button;
       button_style.hover.data.color = RED;
       button_style.active.data.color = RED;
-      button_style.normal.data.color = myChip8.pause_flag ? RED : ctx->style.button.normal.data.color;
+      button_style.normal.data.color = snapshot.chip8.pause_flag ? RED : ctx->style.button.normal.data.color;
 
       nk_layout_row_static(ctx, 15, 50, 1);
       nk_label_colored(ctx, "Status:", NK_TEXT_LEFT, RED);
@@ -369,13 +572,10 @@ static void widget_debug(float x_pos, float y_pos, float width, float height)
 
       nk_layout_row(ctx, NK_STATIC, 20, 2, col_widths);
 
-      nk_label_colored(ctx, "Paused", NK_TEXT_LEFT, myChip8.pause_flag ? CYAN : RED);
+      nk_label_colored(ctx, "Paused", NK_TEXT_LEFT, snapshot.chip8.pause_flag ? CYAN : RED);
       if ( nk_button_label_styled(ctx, &button_style, "Pause") )
       {
-         myChip8.pause_flag = !myChip8.pause_flag;
-
-         if (myChip8.pause_flag) 
-            printf("Paused, press space to step through a single instruction or press f5 again to resume.\n"); 
+         debugger_push_command(COMMAND_TOGGLE_PAUSE, 0);
       }
 
       button_style.normal.data.color = ctx->style.button.normal.data.color;
@@ -383,13 +583,74 @@ static void widget_debug(float x_pos, float y_pos, float width, float height)
       nk_label_colored(ctx, "Tick", NK_TEXT_LEFT, RED);
       if ( nk_button_label_styled(ctx, &button_style,"Cycle Step") )
       {
-         if (myChip8.pause_flag) myChip8.cycle_step_flag = true;
+         debugger_push_command(COMMAND_CYCLE_STEP, 0);
       }
    }
 
    nk_end(ctx);
 }
 
+static void widget_perf(float x_pos, float y_pos, float width, float height)
+{
+   #define PERF_VALUE_BUFFER_SIZE 48
+
+   static char value_buffer[PERF_VALUE_BUFFER_SIZE];
+   static float frame_times[PERF_FRAME_HISTORY];
+
+   if ( nk_begin( ctx, "Perf", nk_rect(x_pos, y_pos, width, height), NK_WINDOW_BORDER|NK_WINDOW_TITLE|NK_WINDOW_NO_SCROLLBAR ) )
+   {
+      PerfStats stats;
+      perf_get_stats(&stats);
+
+      float window_width = nk_window_get_width(ctx);
+      float col_widths[] = { window_width * 0.22, window_width * 0.70 };
+
+      nk_layout_row(ctx, NK_STATIC, 13, 2, col_widths);
+
+      // achieved instructions per second against the clock rate target
+      snprintf(value_buffer, PERF_VALUE_BUFFER_SIZE, "%.0f / %u", stats.instructions_per_second, stats.target_instructions_per_second);
+      nk_label_colored(ctx, "IPS:", NK_TEXT_LEFT, RED);
+      nk_label_colored(ctx, value_buffer, NK_TEXT_LEFT, stats.instructions_per_second < stats.target_instructions_per_second * 0.95 ? RED : CYAN);
+
+      snprintf(value_buffer, PERF_VALUE_BUFFER_SIZE, "p50 %.2f  p99 %.2f ms", stats.frame_time_p50_ms, stats.frame_time_p99_ms);
+      nk_label_colored(ctx, "Frame:", NK_TEXT_LEFT, RED);
+      nk_label(ctx, value_buffer, NK_TEXT_LEFT);
+
+      // run ahead time is only shown while run ahead is on
+      if (stats.run_ahead_time_ms > 0)
+      {
+         snprintf(value_buffer, PERF_VALUE_BUFFER_SIZE, "emu %.2f  ahead %.2f  draw %.2f", stats.emulation_time_ms, stats.run_ahead_time_ms, stats.render_time_ms);
+      }
+      else
+      {
+         snprintf(value_buffer, PERF_VALUE_BUFFER_SIZE, "emu %.2f  render %.2f ms", stats.emulation_time_ms, stats.render_time_ms);
+      }
+      nk_label_colored(ctx, "Split:", NK_TEXT_LEFT, RED);
+      nk_label(ctx, value_buffer, NK_TEXT_LEFT);
+
+      snprintf(value_buffer, PERF_VALUE_BUFFER_SIZE, "%llu frames  %llu underruns", (unsigned long long) stats.dropped_frames, (unsigned long long) stats.audio_underruns);
+      nk_label_colored(ctx, "Drops:", NK_TEXT_LEFT, RED);
+      nk_label(ctx, value_buffer, NK_TEXT_LEFT);
+
+      // rolling frame time graph, scaled so a dropped frame reaches the top
+      int count = perf_get_frame_times(frame_times);
+
+      nk_layout_row_dynamic(ctx, 30, 1);
+      if ( nk_chart_begin_colored(ctx, NK_CHART_LINES, CYAN, RED, count, 0, PERF_DROPPED_FRAME_MS) )
+      {
+         for (int i = 0; i < count; ++i)
+         {
+            nk_chart_push(ctx, frame_times[i]);
+         }
+         nk_chart_end(ctx);
+      }
+   }
+
+   nk_end(ctx);
+
+   #undef PERF_VALUE_BUFFER_SIZE
+}
+
 static void widget_general(float x_pos, float y_pos, float width, float height)
 {
    if ( nk_begin( ctx, "General", nk_rect(x_pos, y_pos, width, height), NK_WINDOW_BORDER|NK_WINDOW_TITLE ) )
@@ -403,16 +664,16 @@ static void widget_general(float x_pos, float y_pos, float width, float height)
       nk_button_set_behavior(ctx, NK_BUTTON_REPEATER);
 
       nk_label_colored(ctx, "Clock Rate: ", NK_TEXT_LEFT, RED);
-      clock_rate = myChip8.clock_rate;
-      nk_property_int(ctx, "Clock Rate:", 1, &clock_rate, 2000, 1, 1);
-      myChip8.clock_rate = clock_rate;
+      clock_rate = snapshot.chip8.clock_rate;
+      nk_property_int(ctx, "Clock Rate:", MIN_CLOCK_RATE, &clock_rate, MAX_CLOCK_RATE, 1, 1);
+      if ( (uint32_t) clock_rate != snapshot.chip8.clock_rate ) debugger_push_command(COMMAND_SET_CLOCK_RATE, clock_rate);
       
       nk_button_set_behavior(ctx, NK_BUTTON_DEFAULT);
 
       nk_label_colored(ctx, "Volume: ", NK_TEXT_LEFT, RED);
       if ( nk_slider_int(ctx, 0, &volume, 5000, 1) )
       {
-         display_set_volume(volume);
+         audio_set_volume(volume);
       }
       
       nk_label_colored(ctx, "Background Color:", NK_TEXT_LEFT, RED);
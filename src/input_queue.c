@@ -0,0 +1,39 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "../includes/input_queue.h"
+
+void input_queue_init(InputQueue *queue)
+{
+   atomic_init(&queue->head, 0);
+   atomic_init(&queue->tail, 0);
+}
+
+bool input_queue_push(InputQueue *queue, InputEvent event)
+{
+   unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+   unsigned int head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+   if (tail - head == INPUT_QUEUE_SIZE) return false; // queue is full
+
+   queue->events[tail & (INPUT_QUEUE_SIZE - 1)] = event;
+
+   // publish the event only after it has been written into its slot
+   atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+   return true;
+}
+
+bool input_queue_pop(InputQueue *queue, InputEvent *event)
+{
+   unsigned int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+   unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+   if (head == tail) return false; // queue is empty
+
+   *event = queue->events[head & (INPUT_QUEUE_SIZE - 1)];
+
+   // release the slot back to the producer only after the event has been read out
+   atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+   return true;
+}
@@ -0,0 +1,203 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "SDL.h"
+
+#include "../includes/perf.h"
+#include "../includes/chip8.h"
+
+// frame timing, only touched by the main thread
+
+static uint64_t frame_start = 0;
+static float frame_times[PERF_FRAME_HISTORY];      // milliseconds
+static float emulation_times[PERF_FRAME_HISTORY];  // milliseconds
+static float render_times[PERF_FRAME_HISTORY];     // milliseconds
+static float run_ahead_times[PERF_FRAME_HISTORY];  // milliseconds
+static uint64_t frame_count = 0;
+static uint64_t dropped_frames = 0;
+
+static float frame_emulation_time = 0;
+static float frame_render_time = 0;
+static float frame_run_ahead_time = 0;
+
+static uint64_t instruction_count = 0;
+
+// instructions per second are measured over windows of about a second
+static uint64_t ips_window_start = 0;
+static uint64_t ips_window_instructions = 0;
+static double instructions_per_second = 0;
+
+// audio timing, the callback runs on the audio thread
+
+static atomic_ullong audio_underruns = 0;
+static atomic_bool audio_restarted = true;
+static uint64_t last_audio_callback = 0; // only touched by the audio thread
+
+static float ticks_to_ms(uint64_t ticks)
+{
+   return (float) ( ticks * 1000.0 / SDL_GetPerformanceFrequency() );
+}
+
+void perf_reset()
+{
+   memset(frame_times, 0, sizeof frame_times);
+   memset(emulation_times, 0, sizeof emulation_times);
+   memset(render_times, 0, sizeof render_times);
+   memset(run_ahead_times, 0, sizeof run_ahead_times);
+   frame_count = 0;
+   dropped_frames = 0;
+   instruction_count = 0;
+   ips_window_start = SDL_GetPerformanceCounter();
+   ips_window_instructions = 0;
+   instructions_per_second = 0;
+
+   atomic_store(&audio_underruns, 0);
+   atomic_store(&audio_restarted, true);
+}
+
+void perf_frame_begin()
+{
+   frame_start = SDL_GetPerformanceCounter();
+   frame_emulation_time = 0;
+   frame_render_time = 0;
+   frame_run_ahead_time = 0;
+}
+
+void perf_record_emulation(uint32_t instructions, uint64_t ticks)
+{
+   instruction_count += instructions;
+   frame_emulation_time += ticks_to_ms(ticks);
+}
+
+void perf_record_render(uint64_t ticks)
+{
+   frame_render_time += ticks_to_ms(ticks);
+}
+
+void perf_record_run_ahead(uint64_t ticks)
+{
+   frame_run_ahead_time += ticks_to_ms(ticks);
+}
+
+void perf_frame_end()
+{
+   uint64_t now = SDL_GetPerformanceCounter();
+   float frame_time = ticks_to_ms(now - frame_start);
+
+   int slot = frame_count % PERF_FRAME_HISTORY;
+   frame_times[slot] = frame_time;
+   emulation_times[slot] = frame_emulation_time;
+   render_times[slot] = frame_render_time;
+   run_ahead_times[slot] = frame_run_ahead_time;
+
+   frame_count++;
+   if (frame_time > PERF_DROPPED_FRAME_MS) dropped_frames++;
+
+   // close the instructions per second window once a second has passed
+   uint64_t frequency = SDL_GetPerformanceFrequency();
+   if (now - ips_window_start >= frequency)
+   {
+      instructions_per_second = (double) ( instruction_count - ips_window_instructions ) * frequency / ( now - ips_window_start );
+      ips_window_start = now;
+      ips_window_instructions = instruction_count;
+   }
+}
+
+void perf_audio_callback(int samples, int sample_rate)
+{
+   uint64_t now = SDL_GetPerformanceCounter();
+
+   // the device was just (re)started, there is no previous callback to measure from
+   if ( atomic_exchange(&audio_restarted, false) )
+   {
+      last_audio_callback = now;
+      return;
+   }
+
+   // the previous buffer lasted this long, allow some slack for scheduling jitter
+   uint64_t buffer_ticks = (uint64_t) samples * SDL_GetPerformanceFrequency() / sample_rate;
+   if (now - last_audio_callback > buffer_ticks + buffer_ticks / 2) atomic_fetch_add(&audio_underruns, 1);
+
+   last_audio_callback = now;
+}
+
+void perf_audio_restart()
+{
+   atomic_store(&audio_restarted, true);
+}
+
+static int compare_floats(const void *a, const void *b)
+{
+   float fa = *(const float*) a, fb = *(const float*) b;
+   return (fa > fb) - (fa < fb);
+}
+
+void perf_get_stats(PerfStats *stats)
+{
+   int count = frame_count < PERF_FRAME_HISTORY ? (int) frame_count : PERF_FRAME_HISTORY;
+
+   stats->instructions_per_second = instructions_per_second;
+
+   // no full second has passed yet, report what the current window achieved so far
+   if (instructions_per_second == 0 && instruction_count > ips_window_instructions)
+   {
+      uint64_t elapsed = SDL_GetPerformanceCounter() - ips_window_start;
+      if (elapsed > 0) stats->instructions_per_second = (double) ( instruction_count - ips_window_instructions ) * SDL_GetPerformanceFrequency() / elapsed;
+   }
+   stats->target_instructions_per_second = myChip8.clock_rate;
+   stats->instructions = instruction_count;
+   stats->frames = frame_count;
+   stats->dropped_frames = dropped_frames;
+   stats->audio_underruns = atomic_load(&audio_underruns);
+
+   stats->frame_time_ms = count ? frame_times[(frame_count - 1) % PERF_FRAME_HISTORY] : 0;
+
+   float emulation_total = 0, render_total = 0, run_ahead_total = 0;
+   int run_ahead_count = 0;
+   for (int i = 0; i < count; ++i)
+   {
+      emulation_total += emulation_times[i];
+      render_total += render_times[i];
+      run_ahead_total += run_ahead_times[i];
+      run_ahead_count += run_ahead_times[i] > 0;
+   }
+   stats->emulation_time_ms = count ? emulation_total / count : 0;
+   stats->render_time_ms = count ? render_total / count : 0;
+
+   // frames that redrew the last run ahead do not lower its cost
+   stats->run_ahead_time_ms = run_ahead_count ? run_ahead_total / run_ahead_count : 0;
+
+   float sorted[PERF_FRAME_HISTORY];
+   memcpy(sorted, frame_times, count * sizeof sorted[0]);
+   qsort(sorted, count, sizeof sorted[0], compare_floats);
+
+   stats->frame_time_p50_ms = count ? sorted[count / 2] : 0;
+   stats->frame_time_p99_ms = count ? sorted[( count * 99 ) / 100] : 0;
+}
+
+int perf_get_frame_times(float times[PERF_FRAME_HISTORY])
+{
+   int count = frame_count < PERF_FRAME_HISTORY ? (int) frame_count : PERF_FRAME_HISTORY;
+   uint64_t first = frame_count - count;
+
+   for (int i = 0; i < count; ++i)
+   {
+      times[i] = frame_times[(first + i) % PERF_FRAME_HISTORY];
+   }
+
+   return count;
+}
+
+void perf_print_stats(const PerfStats *stats)
+{
+   printf("instructions: %llu\n", (unsigned long long) stats->instructions);
+   printf("instructions per second: %.0f (target %u)\n", stats->instructions_per_second, stats->target_instructions_per_second);
+   printf("frames: %llu, dropped: %llu\n", (unsigned long long) stats->frames, (unsigned long long) stats->dropped_frames);
+   printf("frame time: last %.3f ms, p50 %.3f ms, p99 %.3f ms\n", stats->frame_time_ms, stats->frame_time_p50_ms, stats->frame_time_p99_ms);
+   printf("emulation %.3f ms, render %.3f ms per frame\n", stats->emulation_time_ms, stats->render_time_ms);
+   if (stats->run_ahead_time_ms > 0) printf("run ahead %.3f ms per frame that ran ahead\n", stats->run_ahead_time_ms);
+   printf("audio underruns: %llu\n", (unsigned long long) stats->audio_underruns);
+}
@@ -0,0 +1,367 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../includes/profiler.h"
+#include "../includes/chip8.h"
+
+static bool enabled = false;
+
+// executions of the instruction starting at each address
+static uint64_t pc_counts[RAM_SIZE];
+
+// executions of each kind of instruction
+static uint64_t opcode_counts[OPCODE_CLASSES];
+
+static uint64_t max_pc_count = 0;
+static uint64_t total_count = 0;
+
+// guest call stack sampling
+
+typedef struct {
+   uint8_t depth;                      // number of subroutines on the stack, 0 for an unused slot
+   uint16_t entries[MAX_STACK_LEVEL];  // entry address of each subroutine, outermost first
+   uint64_t samples;
+} StackSample;
+
+static uint32_t sample_interval = 0;   // 0 when sampling is off
+static uint32_t sample_countdown = 0;  // instructions left until the next sample
+
+// open addressing hash table of distinct call stacks
+static StackSample stacks[PROFILER_MAX_STACKS];
+static uint64_t top_level_samples = 0; // samples taken while no subroutine was running
+static uint64_t dropped_samples = 0;   // samples of new stacks once the table was full
+
+static void sample_call_stack(void);
+
+static const char *opcode_class_names[OPCODE_CLASSES] =
+{
+   "00E0", "00EE", "00CN", "00DN", "00FB", "00FC", "00FD", "00FE", "00FF", "0NNN",
+   "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "5XY2", "5XY3", "6XNN", "7XNN",
+   "8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5", "8XY6", "8XY7", "8XYE",
+   "9XY0", "ANNN", "BNNN", "CXNN", "DXYN",
+   "EX9E", "EXA1",
+   "F000", "FN01", "F002", "FX07", "FX0A", "FX15", "FX18", "FX1E", "FX29", "FX30", "FX33", "FX3A", "FX55", "FX65", "FX75", "FX85",
+   "????"
+};
+
+void profiler_enable(bool enable)
+{
+   enabled = enable;
+   profiler_reset();
+}
+
+bool profiler_enabled()
+{
+   return enabled;
+}
+
+void profiler_enable_stack_sampling(uint32_t interval)
+{
+   sample_interval = interval;
+   sample_countdown = interval;
+
+   memset(stacks, 0, sizeof stacks);
+   top_level_samples = 0;
+   dropped_samples = 0;
+}
+
+bool profiler_stack_sampling_enabled()
+{
+   return sample_interval > 0;
+}
+
+void profiler_reset()
+{
+   memset(pc_counts, 0, sizeof pc_counts);
+   memset(opcode_counts, 0, sizeof opcode_counts);
+   max_pc_count = 0;
+   total_count = 0;
+}
+
+void profiler_record(uint16_t pc, uint16_t opcode)
+{
+   if (enabled)
+   {
+      uint64_t count = ++pc_counts[pc & (RAM_SIZE - 1)];
+      if (count > max_pc_count) max_pc_count = count;
+
+      opcode_counts[profiler_opcode_class(opcode)]++;
+      total_count++;
+   }
+
+   if (sample_interval && --sample_countdown == 0)
+   {
+      sample_call_stack();
+      sample_countdown = sample_interval;
+   }
+}
+
+// the stack only holds return addresses, the entry address of each subroutine
+// is recovered from the 2NNN instruction just before its return address
+static uint16_t subroutine_entry(uint16_t return_address)
+{
+   uint16_t call_address = ( return_address - 2 ) & (RAM_SIZE - 1);
+   uint16_t opcode = ( myChip8.ram[call_address] << 8 ) | myChip8.ram[(call_address + 1) & (RAM_SIZE - 1)];
+   return opcode & 0x0FFF;
+}
+
+static void sample_call_stack()
+{
+   StackSample sample = { .depth = myChip8.sp, .samples = 0 };
+
+   if (sample.depth == 0)
+   {
+      top_level_samples++;
+      return;
+   }
+
+   if (sample.depth > MAX_STACK_LEVEL) sample.depth = MAX_STACK_LEVEL;
+
+   // fnv-1a hash over the entry addresses
+   uint32_t hash = 2166136261u;
+   for (int level = 0; level < sample.depth; ++level)
+   {
+      sample.entries[level] = subroutine_entry(myChip8.stack[level]);
+      hash = ( hash ^ sample.entries[level] ) * 16777619u;
+   }
+
+   for (int probe = 0; probe < PROFILER_MAX_STACKS; ++probe)
+   {
+      StackSample *slot = &stacks[( hash + probe ) & (PROFILER_MAX_STACKS - 1)];
+
+      if (slot->depth == 0)
+      {
+         *slot = sample;
+         slot->samples = 1;
+         return;
+      }
+
+      if (slot->depth == sample.depth && memcmp(slot->entries, sample.entries, sample.depth * sizeof sample.entries[0]) == 0)
+      {
+         slot->samples++;
+         return;
+      }
+   }
+
+   dropped_samples++;
+}
+
+OpcodeClass profiler_opcode_class(uint16_t opcode)
+{
+   uint8_t last_nibble = opcode & 0x000F;
+   uint8_t last_two_nibble = opcode & 0x00FF;
+
+   switch ( (opcode & 0xF000) >> 12 )
+   {
+      case 0x0:
+      {
+         if (opcode == 0x00E0) return OPCODE_00E0;
+         if (opcode == 0x00EE) return OPCODE_00EE;
+         if ( ( opcode & 0xFFF0 ) == 0x00C0 ) return OPCODE_00CN;
+         if ( ( opcode & 0xFFF0 ) == 0x00D0 ) return OPCODE_00DN;
+         if (opcode == 0x00FB) return OPCODE_00FB;
+         if (opcode == 0x00FC) return OPCODE_00FC;
+         if (opcode == 0x00FD) return OPCODE_00FD;
+         if (opcode == 0x00FE) return OPCODE_00FE;
+         if (opcode == 0x00FF) return OPCODE_00FF;
+         return OPCODE_0NNN;
+      }
+      case 0x1: return OPCODE_1NNN;
+      case 0x2: return OPCODE_2NNN;
+      case 0x3: return OPCODE_3XNN;
+      case 0x4: return OPCODE_4XNN;
+      case 0x5:
+      {
+         switch (last_nibble)
+         {
+            case 0x0: return OPCODE_5XY0;
+            case 0x2: return OPCODE_5XY2;
+            case 0x3: return OPCODE_5XY3;
+            default: return OPCODE_INVALID;
+         }
+      }
+      case 0x6: return OPCODE_6XNN;
+      case 0x7: return OPCODE_7XNN;
+      case 0x8:
+      {
+         switch (last_nibble)
+         {
+            case 0x0: return OPCODE_8XY0;
+            case 0x1: return OPCODE_8XY1;
+            case 0x2: return OPCODE_8XY2;
+            case 0x3: return OPCODE_8XY3;
+            case 0x4: return OPCODE_8XY4;
+            case 0x5: return OPCODE_8XY5;
+            case 0x6: return OPCODE_8XY6;
+            case 0x7: return OPCODE_8XY7;
+            case 0xE: return OPCODE_8XYE;
+            default: return OPCODE_INVALID;
+         }
+      }
+      case 0x9: return last_nibble == 0x0 ? OPCODE_9XY0 : OPCODE_INVALID;
+      case 0xA: return OPCODE_ANNN;
+      case 0xB: return OPCODE_BNNN;
+      case 0xC: return OPCODE_CXNN;
+      case 0xD: return OPCODE_DXYN;
+      case 0xE:
+      {
+         if (last_two_nibble == 0x9E) return OPCODE_EX9E;
+         if (last_two_nibble == 0xA1) return OPCODE_EXA1;
+         return OPCODE_INVALID;
+      }
+      case 0xF:
+      {
+         if (opcode == 0xF000) return OPCODE_F000;
+         if (opcode == 0xF002) return OPCODE_F002;
+
+         switch (last_two_nibble)
+         {
+            case 0x01: return OPCODE_FN01;
+            case 0x07: return OPCODE_FX07;
+            case 0x0A: return OPCODE_FX0A;
+            case 0x15: return OPCODE_FX15;
+            case 0x18: return OPCODE_FX18;
+            case 0x1E: return OPCODE_FX1E;
+            case 0x29: return OPCODE_FX29;
+            case 0x30: return OPCODE_FX30;
+            case 0x33: return OPCODE_FX33;
+            case 0x3A: return OPCODE_FX3A;
+            case 0x55: return OPCODE_FX55;
+            case 0x65: return OPCODE_FX65;
+            case 0x75: return OPCODE_FX75;
+            case 0x85: return OPCODE_FX85;
+            default: return OPCODE_INVALID;
+         }
+      }
+   }
+
+   return OPCODE_INVALID;
+}
+
+const char *profiler_opcode_class_name(OpcodeClass opcode_class)
+{
+   if (opcode_class >= OPCODE_CLASSES) opcode_class = OPCODE_INVALID;
+   return opcode_class_names[opcode_class];
+}
+
+uint64_t profiler_get_pc_count(uint16_t address)
+{
+   return pc_counts[address & (RAM_SIZE - 1)];
+}
+
+uint64_t profiler_get_max_pc_count()
+{
+   return max_pc_count;
+}
+
+uint64_t profiler_get_opcode_count(OpcodeClass opcode_class)
+{
+   if (opcode_class >= OPCODE_CLASSES) return 0;
+   return opcode_counts[opcode_class];
+}
+
+uint64_t profiler_get_total_count()
+{
+   return total_count;
+}
+
+// qsort comparators ordering indices by descending count
+
+static int compare_pc_counts(const void *a, const void *b)
+{
+   uint64_t count_a = pc_counts[*(const uint16_t*) a];
+   uint64_t count_b = pc_counts[*(const uint16_t*) b];
+   return (count_a < count_b) - (count_a > count_b);
+}
+
+static int compare_opcode_counts(const void *a, const void *b)
+{
+   uint64_t count_a = opcode_counts[*(const int*) a];
+   uint64_t count_b = opcode_counts[*(const int*) b];
+   return (count_a < count_b) - (count_a > count_b);
+}
+
+bool profiler_write_collapsed_stacks(const char *file_path)
+{
+   FILE *file = fopen(file_path, "w");
+
+   if (!file)
+   {
+      printf("Cannot open collapsed stack file %s\n", file_path);
+      return false;
+   }
+
+   // every stack is rooted at the program start so all samples share one base frame
+   if (top_level_samples) fprintf(file, "main_%03X %llu\n", PROGRAM_START, (unsigned long long) top_level_samples);
+
+   for (int i = 0; i < PROFILER_MAX_STACKS; ++i)
+   {
+      if (stacks[i].depth == 0) continue;
+
+      fprintf(file, "main_%03X", PROGRAM_START);
+      for (int level = 0; level < stacks[i].depth; ++level)
+      {
+         fprintf(file, ";sub_%03X", stacks[i].entries[level]);
+      }
+      fprintf(file, " %llu\n", (unsigned long long) stacks[i].samples);
+   }
+
+   if (dropped_samples) fprintf(file, "main_%03X;[untracked] %llu\n", PROGRAM_START, (unsigned long long) dropped_samples);
+
+   fclose(file);
+   return true;
+}
+
+bool profiler_write_report(const char *file_path)
+{
+   FILE *file = fopen(file_path, "w");
+
+   if (!file)
+   {
+      printf("Cannot open profile report file %s\n", file_path);
+      return false;
+   }
+
+   static uint16_t addresses[RAM_SIZE];
+   int address_count = 0;
+
+   for (int address = 0; address < RAM_SIZE; ++address)
+   {
+      if (pc_counts[address] > 0) addresses[address_count++] = address;
+   }
+
+   qsort(addresses, address_count, sizeof addresses[0], compare_pc_counts);
+
+   int opcode_classes[OPCODE_CLASSES];
+   for (int i = 0; i < OPCODE_CLASSES; ++i) opcode_classes[i] = i;
+
+   qsort(opcode_classes, OPCODE_CLASSES, sizeof opcode_classes[0], compare_opcode_counts);
+
+   double total = total_count ? (double) total_count : 1;
+
+   fprintf(file, "instructions executed: %llu\n\n", (unsigned long long) total_count);
+
+   fprintf(file, "opcode   count                percent\n");
+   for (int i = 0; i < OPCODE_CLASSES; ++i)
+   {
+      uint64_t count = opcode_counts[opcode_classes[i]];
+      if (count == 0) break;
+
+      fprintf(file, "%-8s %-20llu %6.2f%%\n", opcode_class_names[opcode_classes[i]], (unsigned long long) count, 100.0 * count / total);
+   }
+
+   fprintf(file, "\naddress  opcode  count                percent\n");
+   for (int i = 0; i < address_count; ++i)
+   {
+      uint16_t address = addresses[i];
+      uint16_t opcode = ( myChip8.ram[address] << 8 ) | myChip8.ram[(address + 1) & (RAM_SIZE - 1)];
+
+      fprintf(file, "%04X     %04X    %-20llu %6.2f%%\n", address, opcode, (unsigned long long) pc_counts[address], 100.0 * pc_counts[address] / total);
+   }
+
+   fclose(file);
+   return true;
+}
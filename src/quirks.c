@@ -0,0 +1,33 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "../includes/chip8.h"
+
+// names of the quirk profiles, shared by the emulator and the rom database tool
+static const char *quirk_profile_names[QUIRK_PROFILES] =
+{
+   [QUIRKS_DEFAULT] = "default",
+   [QUIRKS_VIP] = "vip",
+   [QUIRKS_SCHIP] = "schip",
+   [QUIRKS_XOCHIP] = "xochip"
+};
+
+const char *chip8_quirk_profile_name(QuirkProfile profile)
+{
+   if (profile >= QUIRK_PROFILES) return "unknown";
+   return quirk_profile_names[profile];
+}
+
+bool chip8_find_quirk_profile(const char *name, QuirkProfile *profile)
+{
+   for (int i = 0; i < QUIRK_PROFILES; ++i)
+   {
+      if (strcmp(name, quirk_profile_names[i]) == 0)
+      {
+         *profile = i;
+         return true;
+      }
+   }
+
+   return false;
+}
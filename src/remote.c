@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "SDL.h"
+
+#include "../includes/remote.h"
+#include "../includes/display.h"
+#include "../includes/chip8.h"
+
+int remote_encode_frame(const uint8_t *frame, const uint8_t *base, int size, uint8_t *payload, int capacity)
+{
+   uint8_t *out = payload, *end = payload + capacity;
+   int position = 0;
+
+   while (position < size)
+   {
+      int skip = 0, literal = 0;
+
+      while (position + skip < size && skip < 255 && ( frame[position + skip] ^ ( base ? base[position + skip] : 0 ) ) == 0) skip++;
+      position += skip;
+
+      if (end - out < 2) return -1;
+
+      uint8_t *literal_count = out + 1;
+      *out = skip;
+      out += 2;
+
+      while (position < size && literal < 255 && ( frame[position] ^ ( base ? base[position] : 0 ) ) != 0)
+      {
+         if (out == end) return -1;
+
+         *out++ = frame[position] ^ ( base ? base[position] : 0 );
+         position++;
+         literal++;
+      }
+
+      *literal_count = literal;
+   }
+
+   return out - payload;
+}
+
+void remote_write_header(uint8_t *message, uint8_t type, int width, int height, int payload_size)
+{
+   message[0] = type;
+   message[1] = width;
+   message[2] = height;
+   message[3] = payload_size & 0xFF;
+   message[4] = payload_size >> 8;
+}
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+typedef struct {
+   int socket;
+   bool needs_keyframe;
+   uint8_t key_bytes[2]; // key event being received
+   int key_bytes_received;
+   uint8_t pending[REMOTE_BUFFER_SIZE]; // bytes not yet taken by the socket
+   int pending_size;
+} Viewer;
+
+static int listen_socket = -1;
+static char listen_path[sizeof( ( (struct sockaddr_un*) 0 )->sun_path )];
+
+static Viewer viewers[REMOTE_MAX_VIEWERS];
+static int viewer_count = 0;
+
+// frame last sent as a delta, deltas of the next frame are taken against it
+static uint8_t previous_frame[DISPLAY_PACKED_SIZE];
+static int previous_width = 0, previous_height = 0;
+
+static void drop_viewer(int index)
+{
+   close(viewers[index].socket);
+   viewers[index] = viewers[--viewer_count];
+}
+
+// write as much of the pending bytes as the socket takes, returns false if the viewer is gone
+static bool flush_viewer(Viewer *viewer)
+{
+   int sent_total = 0;
+
+   while (sent_total < viewer->pending_size)
+   {
+      ssize_t sent = send(viewer->socket, viewer->pending + sent_total, viewer->pending_size - sent_total, MSG_NOSIGNAL);
+
+      if (sent < 0)
+      {
+         if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+         if (errno == EINTR) continue;
+         return false;
+      }
+
+      sent_total += sent;
+   }
+
+   memmove(viewer->pending, viewer->pending + sent_total, viewer->pending_size - sent_total);
+   viewer->pending_size -= sent_total;
+   return true;
+}
+
+static void queue_message(Viewer *viewer, uint8_t type, int width, int height, const uint8_t *payload, int payload_size)
+{
+   if (viewer->pending_size + REMOTE_HEADER_SIZE + payload_size > REMOTE_BUFFER_SIZE)
+   {
+      // the viewer is too far behind, close it rather than let it hold up the emulation
+      shutdown(viewer->socket, SHUT_RDWR);
+      return;
+   }
+
+   uint8_t *out = viewer->pending + viewer->pending_size;
+   remote_write_header(out, type, width, height, payload_size);
+   memcpy(out + REMOTE_HEADER_SIZE, payload, payload_size);
+
+   viewer->pending_size += REMOTE_HEADER_SIZE + payload_size;
+}
+
+bool remote_open(const char *socket_path)
+{
+   struct sockaddr_un address = { .sun_family = AF_UNIX };
+
+   if (strlen(socket_path) >= sizeof(address.sun_path))
+   {
+      printf("Socket path %s is too long!\n", socket_path);
+      return false;
+   }
+
+   strcpy(address.sun_path, socket_path);
+   strcpy(listen_path, socket_path);
+
+   listen_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (listen_socket < 0)
+   {
+      printf("Cannot create socket: %s\n", strerror(errno));
+      return false;
+   }
+
+   unlink(socket_path);
+
+   if (bind(listen_socket, (struct sockaddr*) &address, sizeof(address)) < 0 || listen(listen_socket, REMOTE_MAX_VIEWERS) < 0)
+   {
+      printf("Cannot listen on socket %s: %s\n", socket_path, strerror(errno));
+      close(listen_socket);
+      listen_socket = -1;
+      return false;
+   }
+
+   fcntl(listen_socket, F_SETFL, fcntl(listen_socket, F_GETFL) | O_NONBLOCK);
+
+   viewer_count = 0;
+   previous_width = previous_height = 0;
+   return true;
+}
+
+bool remote_is_open()
+{
+   return listen_socket >= 0;
+}
+
+void remote_poll()
+{
+   if (listen_socket < 0) return;
+
+   int client;
+   while ( ( client = accept(listen_socket, NULL, NULL) ) >= 0 )
+   {
+      if (viewer_count == REMOTE_MAX_VIEWERS)
+      {
+         close(client);
+         continue;
+      }
+
+      fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+
+      Viewer *viewer = &viewers[viewer_count++];
+      viewer->socket = client;
+      viewer->needs_keyframe = true;
+      viewer->key_bytes_received = 0;
+      viewer->pending_size = 0;
+   }
+
+   uint64_t now = SDL_GetPerformanceCounter();
+
+   for (int i = 0; i < viewer_count; ++i)
+   {
+      Viewer *viewer = &viewers[i];
+      bool connected = true;
+
+      // read key events until the socket has no more
+      while (true)
+      {
+         ssize_t received = recv(viewer->socket, viewer->key_bytes + viewer->key_bytes_received, 2 - viewer->key_bytes_received, 0);
+
+         if (received == 0 || ( received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR ))
+         {
+            connected = false;
+            break;
+         }
+         if (received < 0)
+         {
+            if (errno == EINTR) continue;
+            break;
+         }
+
+         viewer->key_bytes_received += received;
+         if (viewer->key_bytes_received == 2)
+         {
+            chip8_queue_key_event(viewer->key_bytes[0], viewer->key_bytes[1] != 0, now);
+            viewer->key_bytes_received = 0;
+         }
+      }
+
+      if ( !connected || !flush_viewer(viewer) )
+      {
+         drop_viewer(i--);
+      }
+   }
+}
+
+void remote_send_frame()
+{
+   if (listen_socket < 0 || viewer_count == 0) return;
+
+   static uint8_t frame[DISPLAY_PACKED_SIZE];
+   static uint8_t delta[REMOTE_MAX_PAYLOAD_SIZE], keyframe[REMOTE_MAX_PAYLOAD_SIZE];
+
+   int width = display_get_width(), height = display_get_height();
+   int size = display_get_packed(frame);
+
+   // a new resolution invalidates the frame the deltas were taken against
+   bool resized = width != previous_width || height != previous_height;
+   bool changed = resized || memcmp(frame, previous_frame, size) != 0;
+   int delta_size = changed && !resized ? remote_encode_frame(frame, previous_frame, size, delta, sizeof delta) : 0;
+
+   // a delta too large for its buffer is replaced by a keyframe for every viewer
+   bool send_keyframe = resized || delta_size < 0;
+   bool keyframe_encoded = false; // encoded when first needed
+   int keyframe_size = 0;
+
+   for (int i = 0; i < viewer_count; ++i)
+   {
+      Viewer *viewer = &viewers[i];
+
+      if (send_keyframe || viewer->needs_keyframe)
+      {
+         if (!keyframe_encoded) keyframe_size = remote_encode_frame(frame, NULL, size, keyframe, sizeof keyframe);
+         keyframe_encoded = true;
+
+         // the bound covers any frame, a viewer that still cannot be sent one waits for the next keyframe
+         if (keyframe_size >= 0)
+         {
+            queue_message(viewer, REMOTE_KEYFRAME, width, height, keyframe, keyframe_size);
+            viewer->needs_keyframe = false;
+         }
+         else
+         {
+            viewer->needs_keyframe = true;
+         }
+      }
+      else if (changed)
+      {
+         queue_message(viewer, REMOTE_DELTA, width, height, delta, delta_size);
+      }
+
+      if ( !flush_viewer(viewer) ) drop_viewer(i--);
+   }
+
+   memcpy(previous_frame, frame, size);
+   previous_width = width;
+   previous_height = height;
+}
+
+void remote_close()
+{
+   if (listen_socket < 0) return;
+
+   while (viewer_count > 0) drop_viewer(0);
+
+   close(listen_socket);
+   unlink(listen_path);
+   listen_socket = -1;
+}
+
+int remote_get_viewer_count()
+{
+   return viewer_count;
+}
+
+#else
+
+bool remote_open(const char *socket_path)
+{
+   printf("Remote viewers are not supported on this platform!\n");
+   return false;
+}
+
+bool remote_is_open()
+{
+   return false;
+}
+
+void remote_poll() {}
+
+void remote_send_frame() {}
+
+void remote_close() {}
+
+int remote_get_viewer_count()
+{
+   return 0;
+}
+
+#endif
@@ -0,0 +1,175 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "../includes/romdb.h"
+
+// entries are read straight from the mapped file so their layout is part of the file format
+_Static_assert(sizeof (RomDbHeader) == 16, "rom database header layout changed");
+_Static_assert(sizeof (RomDbEntry) == 40, "rom database entry layout changed");
+
+// mapped database file, NULL when no database is open
+static const uint8_t *mapping = NULL;
+static size_t mapping_size = 0;
+
+static const RomDbEntry *entries = NULL;
+static uint32_t entry_count = 0;
+
+#ifdef _WIN32
+static HANDLE file_handle = INVALID_HANDLE_VALUE, mapping_handle = NULL;
+#endif
+
+static const char *platform_names[PLATFORMS] =
+{
+   [PLATFORM_CHIP8] = "chip8",
+   [PLATFORM_SCHIP] = "schip",
+   [PLATFORM_XOCHIP] = "xochip"
+};
+
+// map the whole file read only, returns NULL on error
+static const uint8_t *map_file(const char *file_path, size_t *size)
+{
+#ifdef _WIN32
+   file_handle = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (file_handle == INVALID_HANDLE_VALUE) return NULL;
+
+   LARGE_INTEGER file_size;
+   if ( !GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0 ) return NULL;
+   *size = (size_t) file_size.QuadPart;
+
+   mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+   if (mapping_handle == NULL) return NULL;
+
+   return MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+#else
+   int fd = open(file_path, O_RDONLY);
+   if (fd < 0) return NULL;
+
+   struct stat file_stat;
+   if (fstat(fd, &file_stat) < 0 || file_stat.st_size == 0)
+   {
+      close(fd);
+      return NULL;
+   }
+   *size = file_stat.st_size;
+
+   // the mapping stays valid after the descriptor is closed
+   void *address = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+
+   return address == MAP_FAILED ? NULL : address;
+#endif
+}
+
+static void unmap_file()
+{
+#ifdef _WIN32
+   if (mapping) UnmapViewOfFile(mapping);
+   if (mapping_handle) CloseHandle(mapping_handle);
+   if (file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+   mapping_handle = NULL;
+   file_handle = INVALID_HANDLE_VALUE;
+#else
+   if (mapping) munmap((void*) mapping, mapping_size);
+#endif
+
+   mapping = NULL;
+   mapping_size = 0;
+}
+
+bool romdb_open(const char *file_path)
+{
+   romdb_close();
+
+   mapping = map_file(file_path, &mapping_size);
+
+   if (mapping == NULL)
+   {
+      printf("Cannot map rom database %s\n", file_path);
+      unmap_file();
+      return false;
+   }
+
+   const RomDbHeader *header = (const RomDbHeader*) mapping;
+
+   if ( mapping_size < sizeof *header || memcmp(header->magic, ROMDB_MAGIC, sizeof header->magic) != 0 || header->version != ROMDB_VERSION )
+   {
+      printf("%s is not a rom database!\n", file_path);
+      unmap_file();
+      return false;
+   }
+
+   if ( ( mapping_size - sizeof *header ) / sizeof (RomDbEntry) < header->count )
+   {
+      printf("Rom database %s is truncated!\n", file_path);
+      unmap_file();
+      return false;
+   }
+
+   entries = (const RomDbEntry*) ( mapping + sizeof *header );
+   entry_count = header->count;
+
+   return true;
+}
+
+void romdb_close()
+{
+   unmap_file();
+   entries = NULL;
+   entry_count = 0;
+}
+
+bool romdb_is_open()
+{
+   return mapping != NULL;
+}
+
+const RomDbEntry *romdb_find(const uint8_t sha1[SHA1_DIGEST_SIZE])
+{
+   uint32_t low = 0, high = entry_count;
+
+   while (low < high)
+   {
+      uint32_t middle = low + ( high - low ) / 2;
+      int order = memcmp(entries[middle].sha1, sha1, SHA1_DIGEST_SIZE);
+
+      if (order == 0) return &entries[middle];
+
+      if (order < 0) 
+         low = middle + 1;
+      else 
+         high = middle;
+   }
+
+   return NULL;
+}
+
+const char *romdb_platform_name(Platform platform)
+{
+   if (platform >= PLATFORMS) return "unknown";
+   return platform_names[platform];
+}
+
+bool romdb_find_platform(const char *name, Platform *platform)
+{
+   for (int i = 0; i < PLATFORMS; ++i)
+   {
+      if (strcmp(name, platform_names[i]) == 0)
+      {
+         *platform = i;
+         return true;
+      }
+   }
+
+   return false;
+}
@@ -0,0 +1,121 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "../includes/sha1.h"
+
+static inline uint32_t rotate_left(uint32_t value, int bits)
+{
+   return ( value << bits ) | ( value >> ( 32 - bits ) );
+}
+
+static void sha1_block(Sha1 *sha, const uint8_t *block)
+{
+   uint32_t w[80];
+
+   for (int i = 0; i < 16; ++i)
+   {
+      w[i] = (uint32_t) block[i * 4] << 24 | (uint32_t) block[i * 4 + 1] << 16 | (uint32_t) block[i * 4 + 2] << 8 | block[i * 4 + 3];
+   }
+
+   for (int i = 16; i < 80; ++i)
+   {
+      w[i] = rotate_left(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+   }
+
+   uint32_t a = sha->state[0], b = sha->state[1], c = sha->state[2], d = sha->state[3], e = sha->state[4];
+
+   for (int i = 0; i < 80; ++i)
+   {
+      uint32_t f, k;
+
+      if (i < 20)      { f = ( b & c ) | ( ~b & d );            k = 0x5A827999; }
+      else if (i < 40) { f = b ^ c ^ d;                         k = 0x6ED9EBA1; }
+      else if (i < 60) { f = ( b & c ) | ( b & d ) | ( c & d ); k = 0x8F1BBCDC; }
+      else             { f = b ^ c ^ d;                         k = 0xCA62C1D6; }
+
+      uint32_t temp = rotate_left(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = rotate_left(b, 30);
+      b = a;
+      a = temp;
+   }
+
+   sha->state[0] += a;
+   sha->state[1] += b;
+   sha->state[2] += c;
+   sha->state[3] += d;
+   sha->state[4] += e;
+}
+
+void sha1_init(Sha1 *sha)
+{
+   sha->state[0] = 0x67452301;
+   sha->state[1] = 0xEFCDAB89;
+   sha->state[2] = 0x98BADCFE;
+   sha->state[3] = 0x10325476;
+   sha->state[4] = 0xC3D2E1F0;
+   sha->length = 0;
+   sha->block_used = 0;
+}
+
+void sha1_update(Sha1 *sha, const void *data, size_t size)
+{
+   const uint8_t *bytes = data;
+   sha->length += size;
+
+   while (size > 0)
+   {
+      // hash whole blocks straight from the input when nothing is buffered
+      if (sha->block_used == 0 && size >= sizeof sha->block)
+      {
+         sha1_block(sha, bytes);
+         bytes += sizeof sha->block;
+         size -= sizeof sha->block;
+         continue;
+      }
+
+      size_t count = sizeof sha->block - sha->block_used;
+      if (count > size) count = size;
+
+      memcpy(sha->block + sha->block_used, bytes, count);
+      sha->block_used += count;
+      bytes += count;
+      size -= count;
+
+      if (sha->block_used == sizeof sha->block)
+      {
+         sha1_block(sha, sha->block);
+         sha->block_used = 0;
+      }
+   }
+}
+
+void sha1_final(Sha1 *sha, uint8_t digest[SHA1_DIGEST_SIZE])
+{
+   uint64_t bit_length = sha->length * 8;
+
+   // pad with a single 1 bit then zeros up to the last 8 bytes of a block, which hold the length in bits
+   uint8_t padding = 0x80;
+   sha1_update(sha, &padding, 1);
+
+   padding = 0;
+   while (sha->block_used != sizeof sha->block - 8) sha1_update(sha, &padding, 1);
+
+   uint8_t length_bytes[8];
+   for (int i = 0; i < 8; ++i) length_bytes[i] = bit_length >> ( 56 - 8 * i );
+   sha1_update(sha, length_bytes, sizeof length_bytes);
+
+   for (int i = 0; i < SHA1_DIGEST_SIZE; ++i)
+   {
+      digest[i] = sha->state[i / 4] >> ( 24 - 8 * ( i % 4 ) );
+   }
+}
+
+void sha1(const void *data, size_t size, uint8_t digest[SHA1_DIGEST_SIZE])
+{
+   Sha1 sha;
+   sha1_init(&sha);
+   sha1_update(&sha, data, size);
+   sha1_final(&sha, digest);
+}
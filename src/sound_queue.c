@@ -0,0 +1,50 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "../includes/sound_queue.h"
+
+void sound_queue_init(SoundQueue *queue)
+{
+   atomic_init(&queue->head, 0);
+   atomic_init(&queue->tail, 0);
+}
+
+bool sound_queue_push(SoundQueue *queue, SoundEvent event)
+{
+   unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+   unsigned int head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+   if (tail - head == SOUND_QUEUE_SIZE) return false; // queue is full
+
+   queue->events[tail & (SOUND_QUEUE_SIZE - 1)] = event;
+
+   // publish the event only after it has been written into its slot
+   atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+   return true;
+}
+
+bool sound_queue_peek(SoundQueue *queue, SoundEvent *event)
+{
+   unsigned int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+   unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+   if (head == tail) return false; // queue is empty
+
+   *event = queue->events[head & (SOUND_QUEUE_SIZE - 1)];
+   return true;
+}
+
+bool sound_queue_pop(SoundQueue *queue, SoundEvent *event)
+{
+   unsigned int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+   unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+   if (head == tail) return false; // queue is empty
+
+   *event = queue->events[head & (SOUND_QUEUE_SIZE - 1)];
+
+   // release the slot back to the producer only after the event has been read out
+   atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+   return true;
+}
@@ -0,0 +1,92 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "SDL.h"
+
+#include "../includes/trace.h"
+
+typedef struct {
+   uint64_t start;    // performance counter value when the phase started
+   uint64_t duration; // performance counter ticks the phase took
+   uint8_t phase;
+} TraceRecord;
+
+static bool enabled = false;
+
+static TraceRecord records[TRACE_BUFFER_SIZE];
+
+// total number of records written, the ring buffer holds the last TRACE_BUFFER_SIZE of them
+static uint64_t record_count = 0;
+
+static const char *phase_names[TRACE_PHASES] =
+{
+   "event polling",
+   "emulation",
+   "run ahead",
+   "gui_create_widgets",
+   "display_update",
+   "gui_draw",
+   "display_present",
+   "frame output",
+};
+
+void trace_enable(bool enable)
+{
+   enabled = enable;
+   record_count = 0;
+}
+
+bool trace_enabled()
+{
+   return enabled;
+}
+
+uint64_t trace_begin()
+{
+   return enabled ? SDL_GetPerformanceCounter() : 0;
+}
+
+void trace_end(TracePhase phase, uint64_t start)
+{
+   if (!enabled) return;
+
+   TraceRecord *record = &records[record_count & (TRACE_BUFFER_SIZE - 1)];
+   record->start = start;
+   record->duration = SDL_GetPerformanceCounter() - start;
+   record->phase = phase;
+
+   record_count++;
+}
+
+bool trace_write_chrome_json(const char *file_path)
+{
+   FILE *file = fopen(file_path, "w");
+
+   if (!file)
+   {
+      printf("Cannot open trace file %s\n", file_path);
+      return false;
+   }
+
+   // microseconds per performance counter tick, chrome traces are in microseconds
+   const double tick_to_us = 1000000.0 / SDL_GetPerformanceFrequency();
+
+   uint64_t first = record_count > TRACE_BUFFER_SIZE ? record_count - TRACE_BUFFER_SIZE : 0;
+   uint64_t base_time = record_count ? records[first & (TRACE_BUFFER_SIZE - 1)].start : 0;
+
+   fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+   fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"main loop\"}}");
+
+   for (uint64_t i = first; i < record_count; ++i)
+   {
+      TraceRecord *record = &records[i & (TRACE_BUFFER_SIZE - 1)];
+
+      fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+         phase_names[record->phase], ( record->start - base_time ) * tick_to_us, record->duration * tick_to_us);
+   }
+
+   fprintf(file, "\n]}\n");
+
+   fclose(file);
+   return true;
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../includes/wav.h"
+
+#define WAV_HEADER_SIZE 44
+
+// wav files are little endian regardless of the host
+static void put_u16(uint8_t *bytes, uint16_t value)
+{
+   bytes[0] = value & 0xFF;
+   bytes[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *bytes, uint32_t value)
+{
+   put_u16(bytes, value & 0xFFFF);
+   put_u16(bytes + 2, value >> 16);
+}
+
+static bool write_header(WavWriter *wav)
+{
+   uint8_t header[WAV_HEADER_SIZE] = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' };
+
+   put_u32(header + 4, WAV_HEADER_SIZE - 8 + wav->data_size); // riff chunk size
+   put_u32(header + 16, 16);                                  // fmt chunk size
+   put_u16(header + 20, 1);                                   // pcm
+   put_u16(header + 22, 1);                                   // mono
+   put_u32(header + 24, wav->sample_rate);
+   put_u32(header + 28, wav->sample_rate * 2);                // bytes per second
+   put_u16(header + 32, 2);                                   // bytes per sample frame
+   put_u16(header + 34, 16);                                  // bits per sample
+   header[36] = 'd'; header[37] = 'a'; header[38] = 't'; header[39] = 'a';
+   put_u32(header + 40, wav->data_size);
+
+   return fwrite(header, 1, WAV_HEADER_SIZE, wav->file) == WAV_HEADER_SIZE;
+}
+
+bool wav_open(WavWriter *wav, const char *file_path, int sample_rate)
+{
+   wav->sample_rate = sample_rate;
+   wav->data_size = 0;
+   wav->file = fopen(file_path, "wb");
+
+   if (!wav->file)
+   {
+      printf("Cannot open wav file %s\n", file_path);
+      return false;
+   }
+
+   if ( !write_header(wav) )
+   {
+      printf("Cannot write wav file %s\n", file_path);
+      fclose(wav->file);
+      wav->file = NULL;
+      return false;
+   }
+
+   return true;
+}
+
+bool wav_write(WavWriter *wav, const int16_t *samples, int count)
+{
+   uint8_t bytes[512];
+
+   // convert in chunks so the output is little endian on any host
+   while (count > 0)
+   {
+      int chunk = count < (int) sizeof(bytes) / 2 ? count : (int) sizeof(bytes) / 2;
+
+      for (int i = 0; i < chunk; ++i) put_u16(bytes + i * 2, (uint16_t) samples[i]);
+
+      if ( fwrite(bytes, 2, chunk, wav->file) != (size_t) chunk ) return false;
+
+      wav->data_size += chunk * 2;
+      samples += chunk;
+      count -= chunk;
+   }
+
+   return true;
+}
+
+bool wav_close(WavWriter *wav)
+{
+   // rewrite the header now that the sizes are known
+   bool ok = fseek(wav->file, 0, SEEK_SET) == 0 && write_header(wav);
+   ok = fclose(wav->file) == 0 && ok;
+
+   wav->file = NULL;
+   return ok;
+}
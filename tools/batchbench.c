@@ -0,0 +1,153 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "../includes/batch.h"
+
+/*
+	measures the lockstep batch against the same lanes run as independent interpreters
+
+	batchbench <rom> [lanes] [frames]
+
+	both sides run the rom from the same seeds with the same input, a keypad per lane that changes every
+	KEY_CHANGE_FRAMES frames, so the lanes spread over the rom the way agents playing it do
+	the independent side is one single lane batch per lane, the interpreter without any lockstep
+	the fingerprints of every lane are compared at the end, a mismatch exits with failure
+*/
+
+#define DEFAULT_LANES 256
+#define DEFAULT_FRAMES 600
+
+// frames between two changes of the keys each lane holds
+#define KEY_CHANGE_FRAMES 10
+
+static double now_seconds()
+{
+   struct timespec time;
+   clock_gettime(CLOCK_MONOTONIC, &time);
+   return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// keys lane holds during frame, a different pseudo random set for each lane and key change
+static uint16_t lane_keypad(int lane, int frame)
+{
+   uint32_t x = (uint32_t) lane * 0x9E3779B9 ^ (uint32_t) ( frame / KEY_CHANGE_FRAMES ) * 0x85EBCA6B;
+   x ^= x >> 15;
+   x *= 0x2C1B3C6D;
+   x ^= x >> 12;
+
+   // one or two keys at a time, like a player
+   return 1 << ( x & 15 ) | ( x & 0x100 ? 1 << ( x >> 4 & 15 ) : 0 );
+}
+
+int main(int argc, char *argv[])
+{
+   if (argc < 2)
+   {
+      printf("Usage: batchbench <rom> [lanes] [frames]\n");
+      return EXIT_FAILURE;
+   }
+
+   int lanes = argc > 2 ? atoi(argv[2]) : DEFAULT_LANES;
+   int frames = argc > 3 ? atoi(argv[3]) : DEFAULT_FRAMES;
+
+   if (lanes < 1 || frames < 1)
+   {
+      printf("Lanes and frames must be at least 1\n");
+      return EXIT_FAILURE;
+   }
+
+   FILE *file = fopen(argv[1], "rb");
+
+   if (!file)
+   {
+      printf("Cannot open file %s\n", argv[1]);
+      return EXIT_FAILURE;
+   }
+
+   static uint8_t rom[BATCH_RAM_SIZE];
+   int rom_size = fread(rom, 1, sizeof rom, file);
+   fclose(file);
+
+   const uint32_t seed = 1;
+
+   // lane n of a batch is seeded from seed ^ n * 0x9E3779B9, a single lane batch gets the same seed this way
+   Chip8Batch *batch = batch_create(lanes, rom, rom_size, seed);
+   Chip8Batch **singles = calloc(lanes, sizeof *singles);
+   uint16_t *keypads = calloc(lanes, sizeof *keypads);
+
+   if (!batch || !singles || !keypads)
+   {
+      printf("Cannot create %d lanes of %s\n", lanes, argv[1]);
+      return EXIT_FAILURE;
+   }
+
+   for (int lane = 0; lane < lanes; ++lane)
+   {
+      singles[lane] = batch_create(1, rom, rom_size, seed ^ (uint32_t) lane * 0x9E3779B9);
+
+      if (!singles[lane])
+      {
+         printf("Cannot create %d lanes of %s\n", lanes, argv[1]);
+         return EXIT_FAILURE;
+      }
+   }
+
+   double start = now_seconds();
+
+   for (int frame = 0; frame < frames; ++frame)
+   {
+      for (int lane = 0; lane < lanes; ++lane) keypads[lane] = lane_keypad(lane, frame);
+
+      batch_set_keypads(batch, keypads);
+      batch_run_frame(batch);
+   }
+
+   double batch_time = now_seconds() - start;
+   start = now_seconds();
+
+   for (int frame = 0; frame < frames; ++frame)
+   {
+      for (int lane = 0; lane < lanes; ++lane)
+      {
+         uint16_t keypad = lane_keypad(lane, frame);
+
+         batch_set_keypads(singles[lane], &keypad);
+         batch_run_frame(singles[lane]);
+      }
+   }
+
+   double singles_time = now_seconds() - start;
+
+   int mismatches = 0, halted = 0;
+
+   for (int lane = 0; lane < lanes; ++lane)
+   {
+      if ( batch_hash_lane(batch, lane) != batch_hash_lane(singles[lane], 0) ) mismatches++;
+      if (batch->halted[lane]) halted++;
+   }
+
+   double instructions = (double) lanes * frames * batch->cycles_per_frame;
+
+   printf("%s, %d lanes, %d frames, %d halted\n", argv[1], lanes, frames, halted);
+   printf("lockstep batch:    %8.3f s, %8.1f M instructions/s\n", batch_time, instructions / batch_time / 1e6);
+   printf("independent lanes: %8.3f s, %8.1f M instructions/s\n", singles_time, instructions / singles_time / 1e6);
+   printf("speed up: %.2fx\n", singles_time / batch_time);
+
+   for (int lane = 0; lane < lanes; ++lane) batch_destroy(singles[lane]);
+   batch_destroy(batch);
+   free(singles);
+   free(keypads);
+
+   if (mismatches > 0)
+   {
+      printf("%d lanes ended in a different state than run on their own\n", mismatches);
+      return EXIT_FAILURE;
+   }
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,481 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+
+#include "../includes/chip8.h"
+#include "../includes/display.h"
+#include "../includes/input_queue.h"
+#include "../includes/remote.h"
+
+/*
+	hosts many chip8 sessions for remote clients, linux only
+
+	chip8d <socket path> [worker threads]
+
+	every connection to the socket is one session with its own rom, clock rate and keypad
+	the client starts with an 8 byte header followed by the rom:
+		byte 0, 1: 'C' '8'
+		byte 2: quirk profile, 0 default, 1 vip, 2 schip, 3 xochip
+		byte 3: reserved, 0
+		byte 4, 5: clock rate in hz, little endian, 0 for the default
+		byte 6, 7: rom size in bytes, little endian
+	after that the session speaks the remote viewer protocol of remote.h
+	frames are sent as keyframes and xor deltas, 2 byte key events are read back
+
+	the main thread waits on the sockets and a 60hz timer with epoll
+	on every tick each idle session is queued for the worker pool, which runs its frame of instructions and sends the frame
+	a session still running from the last tick skips the tick, so an overloaded server slows sessions down instead of queueing work
+*/
+
+#define SESSION_HEADER_SIZE 8
+
+// bytes queued per session that the client has not read yet, slower clients are disconnected
+#define SESSION_BUFFER_SIZE 16384
+
+#define MAX_WORKERS 64
+
+typedef struct Session {
+   // chip8 state, only touched by the worker running the session, or the main thread before it starts
+   Chip8 machine;
+   DisplayState display;
+   double cycles_owed;
+
+   // frame the last delta was taken against
+   uint8_t previous_frame[DISPLAY_PACKED_SIZE];
+   int previous_width, previous_height;
+
+   int socket;
+   uint8_t pending[SESSION_BUFFER_SIZE]; // bytes not yet taken by the socket, written by the worker
+   int pending_size;
+
+   // header and rom being received by the main thread
+   uint8_t header[SESSION_HEADER_SIZE];
+   uint8_t *rom;
+   int received, rom_size;
+   bool started;
+
+   // key event being received by the main thread
+   uint8_t key_bytes[2];
+   int key_bytes_received;
+
+   atomic_bool busy;    // queued or running on a worker
+   atomic_bool closing; // the client left or fell behind, freed once not busy
+
+   struct Session *next_queued;
+} Session;
+
+static Session **sessions = NULL;
+static int session_count = 0, session_capacity = 0;
+
+// sessions waiting for a worker, in the order they were queued
+static Session *queue_head = NULL, *queue_tail = NULL;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t session_queued = PTHREAD_COND_INITIALIZER;
+
+static volatile sig_atomic_t quit_flag = 0;
+
+static void handle_signal(int signal_number)
+{
+   (void) signal_number;
+   quit_flag = 1;
+}
+
+static uint64_t now_ns()
+{
+   struct timespec time;
+   clock_gettime(CLOCK_MONOTONIC, &time);
+   return (uint64_t) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+// write as much of the pending bytes as the socket takes, returns false if the client is gone
+static bool flush_session(Session *session)
+{
+   int sent_total = 0;
+
+   while (sent_total < session->pending_size)
+   {
+      ssize_t sent = send(session->socket, session->pending + sent_total, session->pending_size - sent_total, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+      if (sent < 0)
+      {
+         if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+         if (errno == EINTR) continue;
+         return false;
+      }
+
+      sent_total += sent;
+   }
+
+   memmove(session->pending, session->pending + sent_total, session->pending_size - sent_total);
+   session->pending_size -= sent_total;
+   return true;
+}
+
+// run one 60th of a second of the session and send the frame if it changed, called on a worker
+static void run_session(Session *session)
+{
+   uint8_t frame[DISPLAY_PACKED_SIZE];
+   uint8_t message[REMOTE_HEADER_SIZE + REMOTE_MAX_PAYLOAD_SIZE]; // REMOTE_MAX_PAYLOAD_SIZE covers any frame the rom can draw
+
+   // send what the client could not take last time before it falls further behind
+   if ( session->pending_size > 0 && !flush_session(session) )
+   {
+      atomic_store(&session->closing, true);
+      return;
+   }
+
+   chip8_bind(&session->machine);
+   display_bind(&session->display);
+
+   chip8_process_key_events(now_ns());
+
+   chip8_cycle_function run_cycle = chip8_get_cycle_function();
+   session->cycles_owed += myChip8.clock_rate / 60.0;
+   while (session->cycles_owed >= 1)
+   {
+      run_cycle(false);
+      session->cycles_owed -= 1;
+   }
+
+   int width = display_get_width(), height = display_get_height();
+   int size = display_get_packed(frame);
+
+   chip8_bind(NULL);
+   display_bind(NULL);
+
+   bool resized = width != session->previous_width || height != session->previous_height;
+   if ( !resized && memcmp(frame, session->previous_frame, size) == 0 ) return;
+
+   // a delta too large for the message is sent as a keyframe instead
+   bool keyframe = resized;
+   int payload_size = keyframe ? -1 : remote_encode_frame(frame, session->previous_frame, size, message + REMOTE_HEADER_SIZE, REMOTE_MAX_PAYLOAD_SIZE);
+
+   if (payload_size < 0)
+   {
+      keyframe = true;
+      payload_size = remote_encode_frame(frame, NULL, size, message + REMOTE_HEADER_SIZE, REMOTE_MAX_PAYLOAD_SIZE);
+   }
+
+   // never written out, forgetting the resolution sends the next frame as a keyframe
+   if (payload_size < 0)
+   {
+      printf("session %d: frame too large to send, dropped\n", session->socket);
+      session->previous_width = session->previous_height = 0;
+      return;
+   }
+
+   remote_write_header(message, keyframe ? REMOTE_KEYFRAME : REMOTE_DELTA, width, height, payload_size);
+
+   memcpy(session->previous_frame, frame, size);
+   session->previous_width = width;
+   session->previous_height = height;
+
+   int message_size = REMOTE_HEADER_SIZE + payload_size;
+   if (session->pending_size + message_size > SESSION_BUFFER_SIZE)
+   {
+      atomic_store(&session->closing, true);
+      return;
+   }
+
+   memcpy(session->pending + session->pending_size, message, message_size);
+   session->pending_size += message_size;
+
+   if ( !flush_session(session) ) atomic_store(&session->closing, true);
+}
+
+static void *worker_run(void *data)
+{
+   (void) data;
+
+   while (true)
+   {
+      pthread_mutex_lock(&queue_lock);
+      while (queue_head == NULL) pthread_cond_wait(&session_queued, &queue_lock);
+
+      Session *session = queue_head;
+      queue_head = session->next_queued;
+      if (queue_head == NULL) queue_tail = NULL;
+      pthread_mutex_unlock(&queue_lock);
+
+      run_session(session);
+      atomic_store_explicit(&session->busy, false, memory_order_release);
+   }
+
+   return NULL;
+}
+
+static void queue_session(Session *session)
+{
+   session->next_queued = NULL;
+
+   if (queue_tail) queue_tail->next_queued = session;
+   else queue_head = session;
+   queue_tail = session;
+}
+
+// set up the chip8 state once the header and rom are in, called on the main thread before any worker sees the session
+static bool start_session(Session *session)
+{
+   uint8_t profile = session->header[2];
+   uint32_t clock_rate = session->header[4] | session->header[5] << 8;
+
+   chip8_bind(&session->machine);
+   display_bind(&session->display);
+
+   chip8_reset();
+   chip8_set_quirk_profile(profile < QUIRK_PROFILES ? profile : QUIRKS_DEFAULT);
+   if (clock_rate) myChip8.clock_rate = clock_rate;
+   bool loaded = chip8_load_rom_data(session->rom, session->rom_size);
+
+   chip8_bind(NULL);
+   display_bind(NULL);
+
+   free(session->rom);
+   session->rom = NULL;
+
+   if (!loaded) return false;
+
+   printf("session %d started: %d byte rom, %s quirks, %u hz\n", session->socket, session->rom_size, chip8_quirk_profile_name(session->machine.quirk_profile), session->machine.clock_rate);
+   session->started = true;
+   return true;
+}
+
+// read everything the client sent, returns false when the session should close
+static bool receive(Session *session)
+{
+   while (true)
+   {
+      uint8_t bytes[512];
+      ssize_t received = recv(session->socket, bytes, sizeof(bytes), MSG_DONTWAIT);
+
+      if (received == 0) return false;
+      if (received < 0)
+      {
+         if (errno == EINTR) continue;
+         return errno == EAGAIN || errno == EWOULDBLOCK;
+      }
+
+      for (ssize_t i = 0; i < received; ++i)
+      {
+         if (session->received < SESSION_HEADER_SIZE)
+         {
+            session->header[session->received++] = bytes[i];
+
+            if (session->received == SESSION_HEADER_SIZE)
+            {
+               session->rom_size = session->header[6] | session->header[7] << 8;
+               if (session->header[0] != 'C' || session->header[1] != '8' || session->rom_size == 0) return false;
+
+               session->rom = malloc(session->rom_size);
+               if (!session->rom) return false;
+            }
+         }
+         else if (!session->started)
+         {
+            session->rom[session->received++ - SESSION_HEADER_SIZE] = bytes[i];
+
+            if (session->received == SESSION_HEADER_SIZE + session->rom_size && !start_session(session)) return false;
+         }
+         else
+         {
+            // the main thread is the only producer of the input queue, the worker running the session the only consumer
+            session->key_bytes[session->key_bytes_received++] = bytes[i];
+
+            if (session->key_bytes_received == 2)
+            {
+               InputEvent event = { .timestamp = now_ns(), .key = session->key_bytes[0] & 0xF, .down = session->key_bytes[1] != 0 };
+               input_queue_push(&session->machine.input_queue, event);
+               session->key_bytes_received = 0;
+            }
+         }
+      }
+   }
+}
+
+static bool add_session(int client, int epoll_fd)
+{
+   if (session_count == session_capacity)
+   {
+      int capacity = session_capacity ? session_capacity * 2 : 64;
+      Session **grown = realloc(sessions, capacity * sizeof *sessions);
+      if (!grown) return false;
+
+      sessions = grown;
+      session_capacity = capacity;
+   }
+
+   Session *session = calloc(1, sizeof *session);
+   if (!session) return false;
+
+   session->socket = client;
+   atomic_init(&session->busy, false);
+   atomic_init(&session->closing, false);
+
+   struct epoll_event event = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = session };
+   if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client, &event) < 0)
+   {
+      free(session);
+      return false;
+   }
+
+   sessions[session_count++] = session;
+   return true;
+}
+
+// free the sessions that are closing and queue the idle ones for a worker, called on every tick
+static void schedule_sessions()
+{
+   pthread_mutex_lock(&queue_lock);
+
+   for (int i = 0; i < session_count; ++i)
+   {
+      Session *session = sessions[i];
+
+      if ( atomic_load_explicit(&session->busy, memory_order_acquire) ) continue;
+
+      if ( atomic_load(&session->closing) )
+      {
+         printf("session %d closed\n", session->socket);
+         close(session->socket);
+         free(session->rom);
+         free(session);
+         sessions[i--] = sessions[--session_count];
+         continue;
+      }
+
+      if (!session->started) continue;
+
+      atomic_store(&session->busy, true);
+      queue_session(session);
+   }
+
+   pthread_cond_broadcast(&session_queued);
+   pthread_mutex_unlock(&queue_lock);
+}
+
+int main(int argc, char *argv[])
+{
+   if (argc < 2 || argc > 3)
+   {
+      printf("Usage: chip8d <socket path> [worker threads]\n");
+      printf("\t worker threads default to the number of cores, at most %d\n", MAX_WORKERS);
+      return EXIT_FAILURE;
+   }
+
+   long worker_count = argc == 3 ? atol(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+   if (worker_count < 1) worker_count = 1;
+   if (worker_count > MAX_WORKERS) worker_count = MAX_WORKERS;
+
+   struct sockaddr_un address = { .sun_family = AF_UNIX };
+   if (strlen(argv[1]) >= sizeof(address.sun_path))
+   {
+      printf("Socket path %s is too long!\n", argv[1]);
+      return EXIT_FAILURE;
+   }
+   strcpy(address.sun_path, argv[1]);
+
+   int listen_socket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+   unlink(argv[1]);
+
+   if (listen_socket < 0 || bind(listen_socket, (struct sockaddr*) &address, sizeof(address)) < 0 || listen(listen_socket, 128) < 0)
+   {
+      printf("Cannot listen on socket %s: %s\n", argv[1], strerror(errno));
+      return EXIT_FAILURE;
+   }
+
+   // 60hz tick that runs a frame of every session
+   int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+   struct itimerspec period = { .it_interval = { 0, 1000000000 / 60 }, .it_value = { 0, 1000000000 / 60 } };
+   int epoll_fd = epoll_create1(0);
+
+   if (timer_fd < 0 || timerfd_settime(timer_fd, 0, &period, NULL) < 0 || epoll_fd < 0)
+   {
+      printf("Cannot set up the scheduler: %s\n", strerror(errno));
+      return EXIT_FAILURE;
+   }
+
+   // the listening socket and the timer are told apart from sessions by these markers
+   static int listen_marker, timer_marker;
+   struct epoll_event listen_event = { .events = EPOLLIN, .data.ptr = &listen_marker };
+   struct epoll_event timer_event = { .events = EPOLLIN, .data.ptr = &timer_marker };
+   epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_socket, &listen_event);
+   epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &timer_event);
+
+   pthread_t workers[MAX_WORKERS];
+   for (long i = 0; i < worker_count; ++i)
+   {
+      if (pthread_create(&workers[i], NULL, worker_run, NULL) != 0)
+      {
+         printf("Cannot start worker thread %ld\n", i);
+         return EXIT_FAILURE;
+      }
+      pthread_detach(workers[i]);
+   }
+
+   signal(SIGINT, handle_signal);
+   signal(SIGTERM, handle_signal);
+   signal(SIGPIPE, SIG_IGN);
+
+   printf("chip8d listening on %s with %ld workers\n", argv[1], worker_count);
+
+   struct epoll_event events[64];
+
+   while (!quit_flag)
+   {
+      int event_count = epoll_wait(epoll_fd, events, 64, -1);
+
+      // sessions are scheduled after the other events, freeing one earlier could leave a later event pointing at it
+      bool tick_due = false;
+
+      for (int i = 0; i < event_count; ++i)
+      {
+         void *source = events[i].data.ptr;
+
+         if (source == &listen_marker)
+         {
+            int client;
+            while ( ( client = accept4(listen_socket, NULL, NULL, SOCK_NONBLOCK) ) >= 0 )
+            {
+               if ( !add_session(client, epoll_fd) ) close(client);
+            }
+         }
+         else if (source == &timer_marker)
+         {
+            uint64_t expirations;
+            if (read(timer_fd, &expirations, sizeof(expirations)) > 0) tick_due = true;
+         }
+         else
+         {
+            Session *session = source;
+
+            // stop watching a closing session, it is freed on the next tick it is not busy
+            if ( ( events[i].events & ( EPOLLHUP | EPOLLERR ) ) || !receive(session) )
+            {
+               epoll_ctl(epoll_fd, EPOLL_CTL_DEL, session->socket, NULL);
+               atomic_store(&session->closing, true);
+            }
+         }
+      }
+
+      if (tick_due) schedule_sessions();
+   }
+
+   printf("chip8d shutting down\n");
+   unlink(argv[1]);
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,672 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../includes/chip8.h"
+#include "../includes/batch.h"
+
+/*
+	explores the states a rom can reach to find crashes and soft locks, unix only
+
+	explore <rom> [max states] [max depth] [worker threads]
+
+	the rom runs until it reads the keypad with EX9E, EXA1 or FX0A, there the state branches on the input:
+		EX9E and EXA1 on key k branch into k held down and k let go
+		FX0A branches into each of the 16 keys pressed and released
+	each branch is a new state, states are fingerprinted with batch_hash_lane and a state seen before is not run again
+	states are explored breadth first, one depth level at a time spread over the worker threads
+	random numbers follow the sequence of one fixed seed, so the states are the ones reachable with it
+
+	a branch stops with a finding when it:
+		reaches a super chip or xo-chip instruction, which the batch does not run
+		jumps below PROGRAM_START or runs a 0000 opcode, the usual signs of jumping into data
+		overflows or underflows the stack
+		repeats a state without reading input, the rom hangs for good
+		runs MAX_IDLE_FRAMES frames without reading input, a likely soft lock
+	each kind of finding is printed once per address with the inputs that lead to it from reset
+		+k key k held down, -k key k let go, ~k key k pressed and released while waiting at FX0A
+*/
+
+#define DEFAULT_MAX_STATES 100000
+#define DEFAULT_MAX_DEPTH 1000
+#define MAX_WORKERS 64
+
+// frames a branch runs without reading input before it is reported
+#define MAX_IDLE_FRAMES 600
+
+// findings printed, later ones are only counted
+#define MAX_REPORTED 256
+
+// position of the frame phase in a state fingerprint, past every word of the lane state
+#define HASH_FRAME_CYCLES UINT32_MAX
+
+typedef enum {
+   FINDING_UNSUPPORTED,
+   FINDING_BAD_JUMP,
+   FINDING_STACK_OVERFLOW,
+   FINDING_STACK_UNDERFLOW,
+   FINDING_HANG,
+   FINDING_IDLE,
+   FINDINGS,
+} FindingKind;
+
+static const char *finding_names[FINDINGS] =
+{
+   "unsupported instruction",
+   "jump into data",
+   "stack overflow",
+   "stack underflow",
+   "hang",
+   "no input read",
+};
+
+typedef enum {
+   STEP_RESET,
+   STEP_PRESS,
+   STEP_RELEASE,
+   STEP_WAIT_KEY,
+} StepAction;
+
+/*
+	state at a decision point with the input already applied, ready to run the instruction reading it
+	only the registers are kept here, ram and framebuffer rows that differ from the reset state are packed into the
+	rows of the level part holding the node: a 32 bit mask of the non zero framebuffer rows followed by those rows,
+	then a 16 bit count of changed ram rows followed by the index and 8 bytes of each
+*/
+typedef struct {
+   uint8_t V[V_REGISTERS];
+   uint16_t stack[MAX_STACK_LEVEL];
+   uint16_t I;
+   uint16_t PC;
+   uint16_t keypad;
+   uint8_t sp;
+   uint8_t delay_timer;
+   uint8_t sound_timer;
+   uint8_t pressed_key;
+   uint8_t key_released;
+   uint8_t halted;
+   uint8_t frame_cycles;
+   uint32_t random_state;
+   uint64_t memory_hash;
+   size_t rows; // offset of the packed rows
+} Node;
+
+// how a node was reached from its parent, kept for every level to print the inputs leading to a finding
+typedef struct {
+   uint32_t parent;
+   uint8_t key;
+   uint8_t action;
+} Step;
+
+typedef struct {
+   FindingKind kind;
+   uint16_t PC;
+} Finding;
+
+// nodes and steps of one level found by one worker, grown as needed
+typedef struct {
+   Node *nodes;
+   Step *steps;
+   uint32_t size, capacity;
+   uint8_t *rows;
+   size_t rows_size, rows_capacity;
+} LevelPart;
+
+typedef struct {
+   Chip8Batch *batch;   // a single lane, a node carries its own frame phase which lanes of a batch would share
+   LevelPart next;      // children of the level being run, becomes a part of the next frontier
+   BatchLaneState lane; // scratch to pack and unpack nodes
+} Worker;
+
+static Worker workers[MAX_WORKERS];
+static long worker_count = 0;
+
+// ram of the reset state, nodes only keep the rows that differ from it
+static uint8_t reset_ram[BATCH_RAM_SIZE];
+
+// level being run, one part per worker that ran the level before, node i is in the part whose start range holds it
+static LevelPart frontier[MAX_WORKERS];
+static uint32_t frontier_starts[MAX_WORKERS + 1];
+static uint32_t frontier_size = 0;
+static atomic_uint frontier_taken;
+static int depth = 0;
+
+// states the level being filled may still add
+static uint32_t next_capacity = 0;
+static atomic_uint next_size;
+static atomic_bool limit_reached;
+
+// steps of every level run so far, levels[0] holds the reset state
+static Step **levels = NULL;
+
+// open addressing set of state fingerprints, 0 marks an empty slot
+static _Atomic uint64_t *visited = NULL;
+static uint64_t visited_mask = 0;
+
+static pthread_mutex_t report_lock = PTHREAD_MUTEX_INITIALIZER;
+static Finding reported[MAX_REPORTED];
+static int reported_count = 0;
+static uint64_t finding_counts[FINDINGS];
+
+static double now_seconds()
+{
+   struct timespec time;
+   clock_gettime(CLOCK_MONOTONIC, &time);
+   return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// add hash to the visited set, returns false if it was there already
+static bool visit(uint64_t hash)
+{
+   if (hash == 0) hash = 1;
+
+   for (uint64_t slot = hash & visited_mask; ; slot = ( slot + 1 ) & visited_mask)
+   {
+      uint64_t found = atomic_load_explicit(&visited[slot], memory_order_relaxed);
+
+      if (found == 0)
+      {
+         if ( atomic_compare_exchange_strong_explicit(&visited[slot], &found, hash, memory_order_relaxed, memory_order_relaxed) ) return true;
+      }
+
+      // another worker may have just claimed the slot
+      if (found == hash) return false;
+   }
+}
+
+// print the inputs from reset to the node at index of level
+static void print_inputs(int level, uint32_t index)
+{
+   if (level == 0) return;
+
+   static const char action_marks[] = { ' ', '+', '-', '~' };
+   Step step = levels[level][index];
+
+   print_inputs(level - 1, step.parent);
+   printf(" %c%X", action_marks[step.action], step.key);
+}
+
+static void report(FindingKind kind, uint32_t index, uint16_t PC, uint16_t opcode)
+{
+   pthread_mutex_lock(&report_lock);
+
+   finding_counts[kind]++;
+
+   bool seen = false;
+   for (int i = 0; i < reported_count && !seen; ++i) seen = reported[i].kind == kind && reported[i].PC == PC;
+
+   if (!seen && reported_count < MAX_REPORTED)
+   {
+      reported[reported_count++] = (Finding) { .kind = kind, .PC = PC };
+
+      printf("%s at %03x, opcode %04x, depth %d, inputs:", finding_names[kind], PC, opcode, depth);
+      print_inputs(depth, index);
+      printf("\n");
+   }
+
+   pthread_mutex_unlock(&report_lock);
+}
+
+static void *grow(void *buffer, size_t size)
+{
+   void *grown = realloc(buffer, size);
+   if (!grown)
+   {
+      printf("Out of memory\n");
+      exit(EXIT_FAILURE);
+   }
+   return grown;
+}
+
+// pack lane 0 of the batch of worker into a node appended to part
+static void add_node(Worker *worker, LevelPart *part, Step step)
+{
+   BatchLaneState *state = &worker->lane;
+   batch_save_lane(worker->batch, 0, state);
+
+   if (part->size == part->capacity)
+   {
+      part->capacity = part->capacity ? part->capacity * 2 : 256;
+      part->nodes = grow(part->nodes, part->capacity * sizeof(Node));
+      part->steps = grow(part->steps, part->capacity * sizeof(Step));
+   }
+
+   // room for every row, at most 4.4 kb, so the rows can be written without checking
+   size_t most = sizeof(uint32_t) + sizeof state->framebuffer + sizeof(uint16_t) + BATCH_RAM_SIZE / 8 * ( sizeof(uint16_t) + 8 );
+   if (part->rows_size + most > part->rows_capacity)
+   {
+      part->rows_capacity = ( part->rows_size + most ) * 2;
+      part->rows = grow(part->rows, part->rows_capacity);
+   }
+
+   Node *node = &part->nodes[part->size];
+   memcpy(node->V, state->V, sizeof node->V);
+   memcpy(node->stack, state->stack, sizeof node->stack);
+   node->I = state->I;
+   node->PC = state->PC;
+   node->keypad = state->keypad;
+   node->sp = state->sp;
+   node->delay_timer = state->delay_timer;
+   node->sound_timer = state->sound_timer;
+   node->pressed_key = state->pressed_key;
+   node->key_released = state->key_released;
+   node->halted = state->halted;
+   node->frame_cycles = worker->batch->frame_cycles;
+   node->random_state = state->random_state;
+   node->memory_hash = state->memory_hash;
+   node->rows = part->rows_size;
+
+   uint8_t *out = part->rows + part->rows_size;
+   uint32_t framebuffer_mask = 0;
+
+   for (int row = 0; row < BATCH_PIXELS_H; ++row) framebuffer_mask |= (uint32_t) ( state->framebuffer[row] != 0 ) << row;
+
+   memcpy(out, &framebuffer_mask, sizeof framebuffer_mask);
+   out += sizeof framebuffer_mask;
+
+   for (int row = 0; row < BATCH_PIXELS_H; ++row)
+   {
+      if (!state->framebuffer[row]) continue;
+
+      memcpy(out, &state->framebuffer[row], 8);
+      out += 8;
+   }
+
+   uint8_t *ram_count = out;
+   uint16_t changed = 0;
+   out += sizeof changed;
+
+   for (uint16_t row = 0; row < BATCH_RAM_SIZE / 8; ++row)
+   {
+      if ( memcmp(state->ram + row * 8, reset_ram + row * 8, 8) == 0 ) continue;
+
+      memcpy(out, &row, sizeof row);
+      memcpy(out + sizeof row, state->ram + row * 8, 8);
+      out += sizeof row + 8;
+      changed++;
+   }
+
+   memcpy(ram_count, &changed, sizeof changed);
+
+   part->rows_size = out - part->rows;
+   part->steps[part->size++] = step;
+}
+
+// load the node at index of the frontier into lane 0 of the batch of worker
+static void load_node(Worker *worker, uint32_t index)
+{
+   int part_index = 0;
+   while (index >= frontier_starts[part_index + 1]) part_index++;
+
+   const LevelPart *part = &frontier[part_index];
+   const Node *node = &part->nodes[index - frontier_starts[part_index]];
+   BatchLaneState *state = &worker->lane;
+
+   memcpy(state->V, node->V, sizeof state->V);
+   memcpy(state->stack, node->stack, sizeof state->stack);
+   state->I = node->I;
+   state->PC = node->PC;
+   state->keypad = node->keypad;
+   state->sp = node->sp;
+   state->delay_timer = node->delay_timer;
+   state->sound_timer = node->sound_timer;
+   state->pressed_key = node->pressed_key;
+   state->key_released = node->key_released;
+   state->halted = node->halted;
+   state->random_state = node->random_state;
+   state->memory_hash = node->memory_hash;
+
+   const uint8_t *in = part->rows + node->rows;
+   uint32_t framebuffer_mask;
+
+   memcpy(&framebuffer_mask, in, sizeof framebuffer_mask);
+   in += sizeof framebuffer_mask;
+
+   for (int row = 0; row < BATCH_PIXELS_H; ++row)
+   {
+      state->framebuffer[row] = 0;
+      if ( !( framebuffer_mask & ( 1u << row ) ) ) continue;
+
+      memcpy(&state->framebuffer[row], in, 8);
+      in += 8;
+   }
+
+   uint16_t changed, row;
+   memcpy(&changed, in, sizeof changed);
+   in += sizeof changed;
+
+   memcpy(state->ram, reset_ram, BATCH_RAM_SIZE);
+   for (uint16_t i = 0; i < changed; ++i)
+   {
+      memcpy(&row, in, sizeof row);
+      memcpy(state->ram + row * 8, in + sizeof row, 8);
+      in += sizeof row + 8;
+   }
+
+   batch_load_lane(worker->batch, 0, state);
+   worker->batch->frame_cycles = node->frame_cycles;
+}
+
+// fingerprint of the lane state and the frame phase it is at, every state is visited with it
+static uint64_t state_hash(const Chip8Batch *batch)
+{
+   return batch_hash_lane(batch, 0) + batch_hash_word(HASH_FRAME_CYCLES, batch->frame_cycles);
+}
+
+// queue the state of the lane as a node of the next level if it was not seen before
+static void add_child(Worker *worker, uint32_t parent, uint8_t key, StepAction action)
+{
+   if ( atomic_load_explicit(&limit_reached, memory_order_relaxed) ) return;
+
+   Chip8Batch *batch = worker->batch;
+   if ( !visit( state_hash(batch) ) ) return;
+
+   if (atomic_fetch_add(&next_size, 1) >= next_capacity)
+   {
+      atomic_store(&limit_reached, true);
+      return;
+   }
+
+   add_node(worker, &worker->next, (Step) { .parent = parent, .key = key, .action = action });
+}
+
+// branch on the input read by opcode, the lane is left as it was
+static void branch(Worker *worker, uint32_t parent, uint16_t opcode)
+{
+   Chip8Batch *batch = worker->batch;
+   uint16_t keypad = batch->keypad[0];
+   uint8_t pressed_key = batch->pressed_key[0];
+   uint8_t key_released = batch->key_released[0];
+
+   if (( opcode & 0xF0FF ) == 0xF00A)
+   {
+      for (uint8_t key = 0; key < 16; ++key)
+      {
+         batch->keypad[0] = 0;
+         batch->pressed_key[0] = key;
+         batch->key_released[0] = 1;
+         add_child(worker, parent, key, STEP_WAIT_KEY);
+      }
+   }
+   else
+   {
+      uint8_t key = batch->V[( opcode & 0x0F00 ) >> 8][0] & 0xF;
+      uint16_t bit = 1 << key;
+
+      // same key state changes as batch_set_keypads
+      batch->keypad[0] = keypad | bit;
+      if ( !( keypad & bit ) ) batch->pressed_key[0] = key;
+      add_child(worker, parent, key, STEP_PRESS);
+
+      batch->keypad[0] = keypad & ~bit;
+      batch->pressed_key[0] = pressed_key;
+      if (keypad & bit) batch->key_released[0] = 1;
+      add_child(worker, parent, key, STEP_RELEASE);
+   }
+
+   batch->keypad[0] = keypad;
+   batch->pressed_key[0] = pressed_key;
+   batch->key_released[0] = key_released;
+}
+
+static bool reads_input(uint16_t opcode)
+{
+   return ( opcode & 0xF0FF ) == 0xE09E || ( opcode & 0xF0FF ) == 0xE0A1 || ( opcode & 0xF0FF ) == 0xF00A;
+}
+
+// run the node at index of the frontier until it reads input or stops with a finding
+static void run_node(Worker *worker, uint32_t index)
+{
+   Chip8Batch *batch = worker->batch;
+   uint64_t frame_hashes[MAX_IDLE_FRAMES];
+   int frames = 0;
+
+   load_node(worker, index);
+
+   // the instruction a node starts on already had its input decided
+   bool decided = depth > 0;
+
+   while (true)
+   {
+      uint16_t PC = batch->PC[0];
+      uint16_t opcode = batch->ram[PC & ( BATCH_RAM_SIZE - 1 )] << 8 | batch->ram[( PC + 1 ) & ( BATCH_RAM_SIZE - 1 )];
+
+      if (batch->halted[0])
+      {
+         report(FINDING_UNSUPPORTED, index, PC, opcode);
+         return;
+      }
+
+      if (PC < PROGRAM_START || opcode == 0x0000)
+      {
+         report(FINDING_BAD_JUMP, index, PC, opcode);
+         return;
+      }
+
+      if (opcode >> 12 == 0x2 && batch->sp[0] == MAX_STACK_LEVEL)
+      {
+         report(FINDING_STACK_OVERFLOW, index, PC, opcode);
+         return;
+      }
+
+      if (opcode == 0x00EE && batch->sp[0] == 0)
+      {
+         report(FINDING_STACK_UNDERFLOW, index, PC, opcode);
+         return;
+      }
+
+      if (reads_input(opcode) && !decided)
+      {
+         branch(worker, index, opcode);
+         return;
+      }
+
+      decided = false;
+      batch_run(batch, 1);
+
+      if (batch->frame_cycles != 0) continue;
+
+      // without input the lane is deterministic, so a repeated state repeats forever
+      uint64_t hash = batch_hash_lane(batch, 0);
+      for (int frame = 0; frame < frames; ++frame)
+      {
+         if (frame_hashes[frame] == hash)
+         {
+            report(FINDING_HANG, index, batch->PC[0], opcode);
+            return;
+         }
+      }
+
+      if (frames == MAX_IDLE_FRAMES)
+      {
+         report(FINDING_IDLE, index, batch->PC[0], opcode);
+         return;
+      }
+
+      frame_hashes[frames++] = hash;
+   }
+}
+
+static void *run_worker(void *data)
+{
+   Worker *worker = data;
+   uint32_t index;
+
+   while (( index = atomic_fetch_add(&frontier_taken, 1) ) < frontier_size) run_node(worker, index);
+
+   return NULL;
+}
+
+static uint8_t *read_rom(const char *path, int *size)
+{
+   FILE *file = fopen(path, "rb");
+   if (!file)
+   {
+      printf("Cannot open rom %s\n", path);
+      return NULL;
+   }
+
+   uint8_t *rom = malloc(BATCH_RAM_SIZE);
+   *size = rom ? fread(rom, 1, BATCH_RAM_SIZE, file) : 0;
+   fclose(file);
+
+   if (*size < 1 || *size > BATCH_RAM_SIZE - PROGRAM_START)
+   {
+      printf("Rom %s is empty or does not fit into %d bytes of ram\n", path, BATCH_RAM_SIZE);
+      free(rom);
+      return NULL;
+   }
+
+   return rom;
+}
+
+int main(int argc, char *argv[])
+{
+   if (argc < 2 || argc > 5)
+   {
+      printf("Usage: explore <rom> [max states] [max depth] [worker threads]\n");
+      printf("\t max states defaults to %d, max depth to %d\n", DEFAULT_MAX_STATES, DEFAULT_MAX_DEPTH);
+      printf("\t worker threads default to the number of cores, at most %d\n", MAX_WORKERS);
+      return EXIT_FAILURE;
+   }
+
+   long max_states = argc > 2 ? atol(argv[2]) : DEFAULT_MAX_STATES;
+   long max_depth = argc > 3 ? atol(argv[3]) : DEFAULT_MAX_DEPTH;
+   worker_count = argc > 4 ? atol(argv[4]) : sysconf(_SC_NPROCESSORS_ONLN);
+
+   if (max_states < 1 || max_states > UINT32_MAX / 2)
+   {
+      printf("Max states must be between 1 and %u\n", UINT32_MAX / 2);
+      return EXIT_FAILURE;
+   }
+   if (max_depth < 1) max_depth = 1;
+   if (worker_count < 1) worker_count = 1;
+   if (worker_count > MAX_WORKERS) worker_count = MAX_WORKERS;
+
+   int rom_size;
+   uint8_t *rom = read_rom(argv[1], &rom_size);
+   if (!rom) return EXIT_FAILURE;
+
+   for (long i = 0; i < worker_count; ++i)
+   {
+      if ( !( workers[i].batch = batch_create(1, rom, rom_size, 1) ) )
+      {
+         printf("Out of memory\n");
+         return EXIT_FAILURE;
+      }
+   }
+
+   // every batch keeps its own copy
+   free(rom);
+
+   // at most half full keeps probing short
+   uint64_t visited_size = 1;
+   while (visited_size < 2 * (uint64_t) max_states) visited_size <<= 1;
+   visited = calloc(visited_size, sizeof(uint64_t));
+   visited_mask = visited_size - 1;
+
+   levels = malloc(( max_depth + 1 ) * sizeof(Step*));
+   levels[0] = calloc(1, sizeof(Step));
+
+   if (!visited || !levels || !levels[0])
+   {
+      printf("Out of memory\n");
+      return EXIT_FAILURE;
+   }
+
+   // the reset state is the only node of the first level
+   batch_save_lane(workers[0].batch, 0, &workers[0].lane);
+   memcpy(reset_ram, workers[0].lane.ram, BATCH_RAM_SIZE);
+
+   add_node(&workers[0], &frontier[0], levels[0][0]);
+   frontier_size = 1;
+   for (long i = 1; i <= worker_count; ++i) frontier_starts[i] = 1;
+   visit( state_hash(workers[0].batch) );
+
+   uint64_t state_count = 1;
+   double start_time = now_seconds();
+
+   while (frontier_size > 0 && depth < max_depth && !atomic_load(&limit_reached))
+   {
+      if (state_count == (uint64_t) max_states)
+      {
+         atomic_store(&limit_reached, true);
+         break;
+      }
+
+      next_capacity = max_states - state_count;
+      atomic_store(&frontier_taken, 0);
+      atomic_store(&next_size, 0);
+
+      // a worker that cannot be started leaves its share to the others, the main thread runs the level without any
+      pthread_t threads[MAX_WORKERS];
+      long started = 0;
+
+      while ( started < worker_count && pthread_create(&threads[started], NULL, run_worker, &workers[started]) == 0 ) started++;
+
+      if (started < worker_count) printf("Cannot start worker thread %ld, going on with %ld\n", started, started ? started : 1);
+      if (started == 0) run_worker(&workers[0]);
+
+      for (long i = 0; i < started; ++i) pthread_join(threads[i], NULL);
+
+      // the children of every worker make up the next level, their steps are joined into one array per level
+      uint32_t size = 0;
+      for (long i = 0; i < worker_count; ++i) size += workers[i].next.size;
+
+      Step *steps = malloc(( size ? size : 1 ) * sizeof(Step));
+      if (!steps)
+      {
+         printf("Out of memory at depth %d\n", depth);
+         return EXIT_FAILURE;
+      }
+
+      // the parts of the level just run are emptied and reused by the workers for the level after next
+      for (long i = 0; i < worker_count; ++i)
+      {
+         LevelPart done = frontier[i];
+
+         frontier_starts[i] = i ? frontier_starts[i - 1] + frontier[i - 1].size : 0;
+         frontier[i] = workers[i].next;
+         // a worker that found no new states never allocated its steps
+         if (frontier[i].size > 0) memcpy(steps + frontier_starts[i], frontier[i].steps, frontier[i].size * sizeof(Step));
+
+         workers[i].next = done;
+         workers[i].next.size = 0;
+         workers[i].next.rows_size = 0;
+      }
+      frontier_starts[worker_count] = size;
+
+      frontier_size = size;
+      levels[++depth] = steps;
+      state_count += size;
+
+      printf("depth %d: %u new states, %llu in total\n", depth, size, (unsigned long long) state_count);
+   }
+
+   double seconds = now_seconds() - start_time;
+
+   uint64_t finding_count = 0;
+   for (int kind = 0; kind < FINDINGS; ++kind) finding_count += finding_counts[kind];
+
+   printf("Explored %llu states in %.2f s, %.0f states per second\n", (unsigned long long) state_count, seconds, state_count / seconds);
+
+   if ( atomic_load(&limit_reached) ) printf("Stopped at the limit of %ld states\n", max_states);
+   else if (frontier_size > 0) printf("Stopped at the depth limit of %ld\n", max_depth);
+   else printf("Every reachable state was explored\n");
+
+   printf("%llu branches stopped with a finding\n", (unsigned long long) finding_count);
+   for (int kind = 0; kind < FINDINGS; ++kind)
+   {
+      if (finding_counts[kind]) printf("\t %s: %llu\n", finding_names[kind], (unsigned long long) finding_counts[kind]);
+   }
+
+   return finding_count ? 2 : EXIT_SUCCESS;
+}
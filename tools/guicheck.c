@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "SDL.h"
+
+// the same nuklear configuration as the gui, so that its types match
+#define NK_INCLUDE_FIXED_TYPES
+#define NK_INCLUDE_STANDARD_IO
+#define NK_INCLUDE_STANDARD_VARARGS
+#define NK_INCLUDE_DEFAULT_ALLOCATOR
+#define NK_INCLUDE_VERTEX_BUFFER_OUTPUT
+#define NK_INCLUDE_FONT_BAKING
+#define NK_INCLUDE_DEFAULT_FONT
+#include "../nuklear/nuklear.h"
+#include "../includes/nuklear_sdl_renderer.h"
+
+#include "../includes/chip8.h"
+#include "../includes/display.h"
+#include "../includes/debugger.h"
+#include "../includes/gui.h"
+
+/*
+	checks that the gui makes no heap allocations once its buffers have grown to fit
+
+	guicheck [rom] [builds]
+
+	the gui is rebuilt on a dummy video driver with the software renderer, so no window is shown
+	when a rom is given it runs one emulated frame between builds so the widgets have changing state to show
+	the first GUI_WARMUP_BUILDS builds let the renderer buffers grow, after that the allocation count
+	of the counting allocator must stay the same, the check exits with failure when it does not
+	the average time of a build after warm-up is printed so changes to the gui can be measured
+*/
+
+// builds after which the renderer buffers have grown to fit and no more heap allocations are expected
+#define GUI_WARMUP_BUILDS 120
+
+#define DEFAULT_CHECKED_BUILDS 1000
+
+#define DISPLAY_SCALE 15
+
+static void run_frame(chip8_cycle_function run_cycle);
+
+int main(int argc, char *argv[])
+{
+   const char *rom_path = argc > 1 ? argv[1] : NULL;
+   int checked_builds = argc > 2 ? atoi(argv[2]) : DEFAULT_CHECKED_BUILDS;
+
+   if (checked_builds < 1)
+   {
+      printf("Build count must be at least 1\n");
+      return EXIT_FAILURE;
+   }
+
+   // no window or audio device is needed, the renderer draws into memory
+   SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+   SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+   SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+
+   chip8_reset();
+   if ( rom_path && !chip8_load_rom(rom_path) ) return EXIT_FAILURE;
+   myChip8.audio_events = false;
+
+   if ( !display_init(DISPLAY_SCALE, true) ) return EXIT_FAILURE;
+
+   gui_init();
+
+   chip8_cycle_function run_cycle = chip8_get_cycle_function();
+
+   nk_size warm_allocations = 0;
+   uint64_t build_ticks = 0;
+   bool allocated = false;
+
+   for (int build = 0; build < GUI_WARMUP_BUILDS + checked_builds; ++build)
+   {
+      if (rom_path) run_frame(run_cycle);
+
+      gui_input_begin();
+      gui_input_end();
+
+      uint64_t build_start = SDL_GetPerformanceCounter();
+      debugger_publish_snapshot();
+      gui_create_widgets();
+      build_ticks += build >= GUI_WARMUP_BUILDS ? SDL_GetPerformanceCounter() - build_start : 0;
+
+      gui_draw();
+      display_present();
+
+      nk_size allocations = nk_sdl_allocation_count();
+
+      if (build < GUI_WARMUP_BUILDS)
+      {
+         warm_allocations = allocations;
+      }
+      else if (allocations > warm_allocations)
+      {
+         printf("Build %d made %llu heap allocations after warm-up\n", build, (unsigned long long) ( allocations - warm_allocations ));
+         warm_allocations = allocations;
+         allocated = true;
+      }
+   }
+
+   printf("%d builds after warm-up, %.3f ms per build\n", checked_builds, build_ticks * 1000.0 / SDL_GetPerformanceFrequency() / checked_builds);
+
+   gui_close();
+   display_close();
+
+   if (allocated) return EXIT_FAILURE;
+
+   printf("No heap allocations after warm-up\n");
+   return EXIT_SUCCESS;
+}
+
+// run the instructions of one 60hz emulated frame, audio is not opened so none is queued
+static void run_frame(chip8_cycle_function run_cycle)
+{
+   uint64_t last_frame = myChip8.frame_count + 1;
+   while (myChip8.frame_count < last_frame) run_cycle(false);
+}
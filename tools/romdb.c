@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../includes/chip8.h"
+#include "../includes/romdb.h"
+#include "../includes/sha1.h"
+
+/*
+	builds rom databases for chip8 -D
+
+	romdb hash <rom files>
+		print the sha-1 of each rom, ready to paste into a database source file
+
+	romdb build <source file> <database file>
+		compile a text source file into a database, one rom per line:
+		<sha-1> <platform> <quirk profile> <cycles per frame> [<background> <foreground> <color 2> <color 3>]
+		platforms are chip8, schip and xochip, quirk profiles are default, vip, schip and xochip
+		colors are RRGGBB hex or - to keep the color the emulator would otherwise use
+		empty lines and lines starting with # are skipped
+*/
+
+#define LINE_SIZE 512
+
+static bool parse_sha1(const char *hex, uint8_t digest[SHA1_DIGEST_SIZE])
+{
+   if (strlen(hex) != SHA1_DIGEST_SIZE * 2) return false;
+
+   for (int i = 0; i < SHA1_DIGEST_SIZE; ++i)
+   {
+      unsigned int byte;
+      if (sscanf(hex + i * 2, "%2x", &byte) != 1) return false;
+      digest[i] = byte;
+   }
+
+   return true;
+}
+
+static bool parse_color(const char *text, uint32_t *argb)
+{
+   if (strcmp(text, "-") == 0)
+   {
+      *argb = 0;
+      return true;
+   }
+
+   char *end;
+   unsigned long rgb = strtoul(text, &end, 16);
+   if (*end != '\0' || strlen(text) != 6) return false;
+
+   *argb = 0xFF000000 | rgb;
+   return true;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+   return memcmp(( (const RomDbEntry*) a )->sha1, ( (const RomDbEntry*) b )->sha1, SHA1_DIGEST_SIZE);
+}
+
+static int hash_roms(int count, char *paths[])
+{
+   // one byte more than the emulator loads so that a rom it would refuse is noticed
+   static uint8_t rom[RAM_SIZE - PROGRAM_START + 1];
+   int status = EXIT_SUCCESS;
+
+   for (int i = 0; i < count; ++i)
+   {
+      FILE *file = fopen(paths[i], "rb");
+
+      if (!file)
+      {
+         printf("Cannot open file %s\n", paths[i]);
+         status = EXIT_FAILURE;
+         continue;
+      }
+
+      size_t size = fread(rom, 1, sizeof rom, file);
+      fclose(file);
+
+      // the emulator refuses these, a hash of them could never be looked up
+      if (size == 0 || size > RAM_SIZE - PROGRAM_START)
+      {
+         printf("%s is empty or too large to load into chip8 ram\n", paths[i]);
+         status = EXIT_FAILURE;
+         continue;
+      }
+
+      uint8_t digest[SHA1_DIGEST_SIZE];
+      sha1(rom, size, digest);
+
+      for (int byte = 0; byte < SHA1_DIGEST_SIZE; ++byte) printf("%02x", digest[byte]);
+      printf("  %s\n", paths[i]);
+   }
+
+   return status;
+}
+
+static int build_database(const char *source_path, const char *database_path)
+{
+   FILE *source = fopen(source_path, "r");
+
+   if (!source)
+   {
+      printf("Cannot open file %s\n", source_path);
+      return EXIT_FAILURE;
+   }
+
+   RomDbEntry *entries = NULL;
+   uint32_t count = 0, capacity = 0;
+
+   char line[LINE_SIZE];
+   int line_number = 0;
+
+   while ( fgets(line, sizeof line, source) )
+   {
+      line_number++;
+
+      char hash[64], platform[32], profile[32], colors[ROMDB_COLORS][16];
+      unsigned int cycles_per_frame;
+
+      int fields = sscanf(line, "%63s %31s %31s %u %15s %15s %15s %15s", hash, platform, profile, &cycles_per_frame, colors[0], colors[1], colors[2], colors[3]);
+      if (fields <= 0 || hash[0] == '#') continue;
+
+      if (count == capacity)
+      {
+         uint32_t new_capacity = capacity ? capacity * 2 : 256;
+         RomDbEntry *new_entries = realloc(entries, new_capacity * sizeof *entries);
+
+         if (!new_entries)
+         {
+            printf("Out of memory reading %s\n", source_path);
+            fclose(source);
+            free(entries);
+            return EXIT_FAILURE;
+         }
+
+         entries = new_entries;
+         capacity = new_capacity;
+      }
+
+      RomDbEntry *entry = &entries[count];
+      memset(entry, 0, sizeof *entry);
+
+      Platform platform_value;
+      QuirkProfile profile_value;
+
+      bool valid = ( fields == 4 || fields == 8 ) && parse_sha1(hash, entry->sha1) && romdb_find_platform(platform, &platform_value) && chip8_find_quirk_profile(profile, &profile_value) && cycles_per_frame <= MAX_CLOCK_RATE / 60;
+
+      for (int color = 0; valid && fields == 8 && color < ROMDB_COLORS; ++color)
+      {
+         valid = parse_color(colors[color], &entry->colors[color]);
+      }
+
+      if (!valid)
+      {
+         printf("%s:%d: expected <sha-1> <platform> <quirk profile> <cycles per frame> [4 colors]\n", source_path, line_number);
+         fclose(source);
+         free(entries);
+         return EXIT_FAILURE;
+      }
+
+      entry->platform = platform_value;
+      entry->quirk_profile = profile_value;
+      entry->cycles_per_frame = cycles_per_frame;
+      count++;
+   }
+
+   fclose(source);
+
+   qsort(entries, count, sizeof *entries, compare_entries);
+
+   for (uint32_t i = 1; i < count; ++i)
+   {
+      if (compare_entries(&entries[i - 1], &entries[i]) == 0)
+      {
+         printf("Duplicate rom in %s, every sha-1 may only appear once!\n", source_path);
+         free(entries);
+         return EXIT_FAILURE;
+      }
+   }
+
+   FILE *database = fopen(database_path, "wb");
+
+   if (!database)
+   {
+      printf("Cannot open file %s\n", database_path);
+      free(entries);
+      return EXIT_FAILURE;
+   }
+
+   RomDbHeader header = { .version = ROMDB_VERSION, .count = count };
+   memcpy(header.magic, ROMDB_MAGIC, sizeof header.magic);
+
+   bool written = fwrite(&header, sizeof header, 1, database) == 1 && fwrite(entries, sizeof *entries, count, database) == count;
+   written = fclose(database) == 0 && written;
+   free(entries);
+
+   if (!written)
+   {
+      printf("File writing error!\n");
+      return EXIT_FAILURE;
+   }
+
+   printf("%u roms written to %s\n", count, database_path);
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+   if (argc >= 3 && strcmp(argv[1], "hash") == 0) return hash_roms(argc - 2, argv + 2);
+   if (argc == 4 && strcmp(argv[1], "build") == 0) return build_database(argv[2], argv[3]);
+
+   printf("Usage: romdb hash <rom files>\n");
+   printf("       romdb build <source file> <database file>\n");
+   printf("\t source files have one rom per line: <sha-1> <platform> <quirk profile> <cycles per frame> [<background> <foreground> <color 2> <color 3>]\n");
+   return EXIT_FAILURE;
+}